@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#==============================================================
+# Copyright (C) Intel Corporation
+#
+# SPDX-License-Identifier: MIT
+# =============================================================
+
+import os
+import sys
+import argparse
+
+# A container (<hostname>.unitrace) holds the trace files of all processes on a node as blocks:
+#   #UNITRACE file=<name> pid=<pid> rank=<rank> size=<bytes>\n<bytes of the trace file>
+# <hostname>.unitrace.idx has one "<name> <pid> <rank> <offset> <bytes>" line per block.
+
+def ParseCommandLineArgs():
+    parser = argparse.ArgumentParser(description = 'List or extract trace files stored in a unitrace container')
+    parser.add_argument('container', help = 'container file (<hostname>.unitrace)')
+    parser.add_argument('-l', '--list', action = 'store_true', help = 'list trace files in the container')
+    parser.add_argument('-r', '--rank', action = 'append', help = 'extract trace files of this rank (can be repeated)')
+    parser.add_argument('-p', '--pid', action = 'append', help = 'extract trace files of this process (can be repeated)')
+    parser.add_argument('-a', '--all', action = 'store_true', help = 'extract all trace files')
+    parser.add_argument('-o', '--outputDir', default = '.', help = 'directory for extracted files')
+
+    return parser.parse_args()
+
+def ScanContainer(container):
+    # rebuild the index from block headers when the index file is missing
+    entries = []
+    with open(container, 'rb') as fp:
+        while True:
+            header = fp.readline()
+            if not header:
+                break
+            fields = dict(f.split('=', 1) for f in header.decode().split()[1:])
+            offset = fp.tell()
+            size = int(fields['size'])
+            entries.append((fields['file'], fields['pid'], fields['rank'], offset, size))
+            fp.seek(size, os.SEEK_CUR)
+    return entries
+
+def ReadIndex(container):
+    index = container + '.idx'
+    if not os.path.isfile(index):
+        return ScanContainer(container)
+
+    entries = []
+    with open(index, 'r') as fp:
+        for line in fp:
+            fields = line.split()
+            if (len(fields) == 5):
+                entries.append((fields[0], fields[1], fields[2], int(fields[3]), int(fields[4])))
+    return entries
+
+def Extract(container, entry, outputDir):
+    name, pid, rank, offset, size = entry
+    output = os.path.join(outputDir, name)
+    with open(container, 'rb') as ifp, open(output, 'wb') as ofp:
+        ifp.seek(offset, os.SEEK_SET)
+        remaining = size
+        while (remaining > 0):
+            data = ifp.read(min(remaining, 1 << 22))
+            if not data:
+                print("Trace file " + name + " is truncated in container " + container)
+                break
+            ofp.write(data)
+            remaining -= len(data)
+    print("Extracted " + output)
+
+if __name__ == "__main__":
+    args = ParseCommandLineArgs()
+
+    entries = ReadIndex(args.container)
+
+    if args.list or not (args.all or args.rank or args.pid):
+        print('%-40s %10s %8s %16s' % ('File', 'PID', 'Rank', 'Size (bytes)'))
+        for name, pid, rank, offset, size in entries:
+            print('%-40s %10s %8s %16d' % (name, pid, rank, size))
+        sys.exit(0)
+
+    os.makedirs(args.outputDir, exist_ok = True)
+    for entry in entries:
+        if args.all or (args.rank and entry[2] in args.rank) or (args.pid and entry[1] in args.pid):
+            Extract(args.container, entry, args.outputDir)
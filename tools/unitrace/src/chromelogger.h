@@ -28,6 +28,9 @@
 #include "unikernel.h"
 #include "unievent.h"
 #include "unimemory.h"
+#include "unistage.h"
+#include "unicontainer.h"
+#include "unishm.h"
 #include <atomic>
 
 #include "common_header.gen"
@@ -65,6 +68,16 @@ static std::string EncodeURI(const std::string &input) {
 
 static Logger* logger_ = nullptr;
 std::recursive_mutex logger_lock_; //lock to synchronize file write
+static ShmPublisher* shm_publisher_ = nullptr;	// events go to the launcher's collector instead of logger_
+static std::map<std::string, std::string> process_metadata_;	// key -> JSON value, guarded by logger_lock_
+
+// Resolves an ITT task to its thread and time span when a relation between tasks is written
+typedef bool (*OnIttTaskLookupCallback)(uint64_t task, uint32_t& tid, uint64_t& start_ts, uint64_t& end_ts);
+static OnIttTaskLookupCallback itt_task_lookup_ = nullptr;
+
+// Resolves a function to its name, in the modules loaded at the time, when an event named after the function is written
+typedef const char *(*OnIttSymbolLookupCallback)(const void *fn, uint64_t ts);
+static OnIttSymbolLookupCallback itt_symbol_lookup_ = nullptr;
 
 #if BUILD_WITH_ITT
 static std::string convertDataToString(IttArgs* args) {
@@ -169,99 +182,205 @@ static std::string convertDataToString(IttArgs* args) {
 }
 #endif /* BUILD_WITH_ITT */
 
+// Free the data and the rest of the arguments. The first argument is held by the caller.
+static void ReleaseIttArgs(IttArgs* args) {
+  if (args->count == 0) {
+    return;
+  }
+  if (args->isIndirectData) {
+    free(args->data[0]);
+  }
+  IttArgs* next = args->next;
+  while (next != nullptr) {
+    IttArgs* toFree = next;
+    next = next->next;
+    free(toFree);
+  }
+  args->count = 0;
+}
+
+// Arguments of a task kept with an MPI event, nullptr if there are none
+static IttArgs* MoveIttArgs(IttArgs* metadata_args) {
+  if (metadata_args->count == 0) {
+    return nullptr;
+  }
+  IttArgs* args = (IttArgs *)malloc(sizeof(IttArgs));
+  UniMemory::ExitIfOutOfMemory((void *)args);
+  *args = *metadata_args;
+  return args;
+}
+
 class TraceBuffer;
-std::set<TraceBuffer *> *trace_buffers_ = nullptr;
+std::atomic<TraceBuffer *> trace_buffers_{nullptr};	// all buffers ever created, they are recycled but never freed
+std::atomic<bool> trace_buffers_finalized_{false};
+
+// Set in a forked child until the child logs its first event, see ChromeLogger::ChildAfterFork()
+typedef void (*OnTraceOpenCallback)(void);
+static std::atomic<OnTraceOpenCallback> trace_open_pending_{nullptr};
 
 #define BUFFER_SLICE_SIZE_DEFAULT	(0x1 << 20)
 
-class TraceBuffer {
-  public:
-    TraceBuffer() : flush_immediately_(false) {
+struct TraceBufferConfig {
+  int32_t buffer_capacity_;
+  int32_t slice_capacity_;
+  bool flush_immediately_;
+  bool metrics_enabled_;
+
+  // environment is parsed once per process instead of once per thread
+  static const TraceBufferConfig& Get(void) {
+    static TraceBufferConfig config = Read();
+    return config;
+  }
+
+  private:
+    static TraceBufferConfig Read(void) {
+      TraceBufferConfig config;
+      config.flush_immediately_ = false;
       std::string szstr = utils::GetEnv("UNITRACE_ChromeEventBufferSize");
       if (szstr.empty() || (szstr == "-1")) {
-        buffer_capacity_ = -1;
-        slice_capacity_ = BUFFER_SLICE_SIZE_DEFAULT;
+        config.buffer_capacity_ = -1;
+        config.slice_capacity_ = BUFFER_SLICE_SIZE_DEFAULT;
       }
       else {
-        buffer_capacity_ = std::stoi(szstr);
-        if (buffer_capacity_ == 0) {
-          buffer_capacity_ = 1;	// at least one event slot
-          flush_immediately_ = true;
+        config.buffer_capacity_ = std::stoi(szstr);
+        if (config.buffer_capacity_ == 0) {
+          config.buffer_capacity_ = 1;	// at least one event slot
+          config.flush_immediately_ = true;
         }
-        slice_capacity_ = buffer_capacity_;
+        config.slice_capacity_ = config.buffer_capacity_;
       }
+      if ((utils::GetEnv("UNITRACE_MetricQuery") == "1") || (utils::GetEnv("UNITRACE_KernelMetrics") == "1")) {
+        config.metrics_enabled_ = true;
+      }
+      else {
+        config.metrics_enabled_ = false;
+      }
+      return config;
+    }
+};
 
-      HostEventRecord *her = (HostEventRecord *)(malloc(sizeof(HostEventRecord) * slice_capacity_));
-      UniMemory::ExitIfOutOfMemory((void *)(her));
+enum TRACE_BUFFER_STATE {
+  TRACE_BUFFER_FREE = 0,
+  TRACE_BUFFER_IN_USE,	// owned by a live thread
+  TRACE_BUFFER_RETIRED,	// owner has exited, events are not flushed yet
+};
 
-      host_event_buffer_.push_back(her);
-      tid_= utils::GetTid();
-      pid_= utils::GetPid();
+// Host events of one thread.
+// A buffer is taken from the pool on the first event of a thread and handed back, events and
+// all, without taking any lock when the thread exits. Retired buffers are flushed by the next
+// thread that needs a buffer when there is no free one, or at finalization.
+class TraceBuffer {
+  public:
+    TraceBuffer(const TraceBuffer& that) = delete;
+    TraceBuffer& operator=(const TraceBuffer& that) = delete;
 
-      current_host_event_buffer_slice_ = 0;
-      next_host_event_index_ = 0;
-      host_event_buffer_flushed_ = false;
-      finalized_.store(false, std::memory_order_release);
-      if ((utils::GetEnv("UNITRACE_MetricQuery") == "1") || (utils::GetEnv("UNITRACE_KernelMetrics") == "1")) {
-        metrics_enabled_ = true;
+    static TraceBuffer *Acquire(void) {
+      if (trace_open_pending_.load(std::memory_order_acquire) != nullptr) {
+        std::lock_guard<std::recursive_mutex> lock(logger_lock_);
+        OnTraceOpenCallback open = trace_open_pending_.load(std::memory_order_acquire);
+        if (open != nullptr) {
+          open();
+          trace_open_pending_.store(nullptr, std::memory_order_release);
+        }
       }
-      else {
-        metrics_enabled_ = false;
+
+      TraceBuffer *buffer;
+      for (buffer = trace_buffers_.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next_) {
+        uint32_t expected = TRACE_BUFFER_FREE;
+        if (buffer->state_.compare_exchange_strong(expected, TRACE_BUFFER_IN_USE, std::memory_order_acq_rel)) {
+          buffer->Reset();
+          return buffer;
+        }
       }
 
-      std::lock_guard<std::recursive_mutex> lock(logger_lock_);	// use this lock to protect trace_buffers_
+      for (buffer = trace_buffers_.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next_) {
+        uint32_t expected = TRACE_BUFFER_RETIRED;
+        if (buffer->state_.compare_exchange_strong(expected, TRACE_BUFFER_IN_USE, std::memory_order_acq_rel)) {
+          std::lock_guard<std::recursive_mutex> lock(logger_lock_);
+          if (!buffer->finalized_.load(std::memory_order_acquire)) {
+            buffer->FlushHostBuffer();
+          }
+          buffer->ReleaseRing();
+          buffer->Reset();
+          return buffer;
+        }
+      }
 
-      if (trace_buffers_ == NULL) {
-        trace_buffers_ = new std::set<TraceBuffer *>;
-        UniMemory::ExitIfOutOfMemory((void *)(trace_buffers_));
+      buffer = new TraceBuffer();
+      UniMemory::ExitIfOutOfMemory((void *)(buffer));
+      buffer->Reset();
+      TraceBuffer *head = trace_buffers_.load(std::memory_order_relaxed);
+      do {
+        buffer->next_ = head;
+      } while (!trace_buffers_.compare_exchange_weak(head, buffer, std::memory_order_seq_cst, std::memory_order_relaxed));
+      if (trace_buffers_finalized_.load(std::memory_order_seq_cst)) {
+        // FinalizeAll() may have walked the list before the buffer was linked
+        buffer->finalized_.store(true, std::memory_order_release);
       }
-      trace_buffers_->insert(this);
+      return buffer;
+    }
+
+    // Called by the owner thread at exit
+    void Retire(void) {
+      state_.store(TRACE_BUFFER_RETIRED, std::memory_order_release);
     }
 
-    ~TraceBuffer() {
+    // Flush every buffer that is in use or retired. No event is buffered afterwards.
+    static void FinalizeAll(void) {
       std::lock_guard<std::recursive_mutex> lock(logger_lock_);
-      if (!finalized_.exchange(true)) {
-        // finalize if not finalized
-        if (!host_event_buffer_flushed_) {
-          for (int i = 0; i < current_host_event_buffer_slice_; i++) {
-            for (int j = 0; j < slice_capacity_; j++) {
-              FlushHostEvent(host_event_buffer_[i][j]);
-            }
-          }
-          for (int j = 0; j < next_host_event_index_; j++) {
-            FlushHostEvent(host_event_buffer_[current_host_event_buffer_slice_][j]);
-          }
-          host_event_buffer_flushed_ = true;
+      trace_buffers_finalized_.store(true, std::memory_order_seq_cst);
+      for (TraceBuffer *buffer = trace_buffers_.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next_) {
+        if (buffer->state_.load(std::memory_order_acquire) != TRACE_BUFFER_FREE) {
+          buffer->Finalize();
         }
+      }
+    }
 
-        for (auto& slice : host_event_buffer_) {
-          free(slice);
+    // Called in a forked child before its first event. The buffered events belong to the parent,
+    // which writes them, so they are dropped here and every buffer goes back to the pool.
+    static void DiscardAllAfterFork(void) {
+      for (TraceBuffer *buffer = trace_buffers_.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next_) {
+        if (buffer->state_.load(std::memory_order_acquire) == TRACE_BUFFER_FREE) {
+          continue;
         }
-        host_event_buffer_.clear();
-        trace_buffers_->erase(this);
+        if (!buffer->finalized_.load(std::memory_order_acquire)) {
+          buffer->DiscardHostBuffer();
+        }
+        if (buffer->shm_ring_ != nullptr) {
+          buffer->shm_ring_->Detach();
+          delete buffer->shm_ring_;
+          buffer->shm_ring_ = nullptr;
+        }
+        buffer->state_.store(TRACE_BUFFER_FREE, std::memory_order_release);
       }
     }
 
-    TraceBuffer(const TraceBuffer& that) = delete;
-    TraceBuffer& operator=(const TraceBuffer& that) = delete;
-
     HostEventRecord *GetHostEvent(void) {
       if (next_host_event_index_ ==  slice_capacity_) {
         if (buffer_capacity_ == -1) {
-          HostEventRecord *her = (HostEventRecord *)(malloc(sizeof(HostEventRecord) * slice_capacity_));
-          UniMemory::ExitIfOutOfMemory((void *)(her));
-          host_event_buffer_.push_back(her);
           current_host_event_buffer_slice_++;
+          if (current_host_event_buffer_slice_ == (int32_t)host_event_buffer_.size()) {
+            HostEventRecord *her = (HostEventRecord *)(malloc(sizeof(HostEventRecord) * slice_capacity_));
+            UniMemory::ExitIfOutOfMemory((void *)(her));
+            host_event_buffer_.push_back(her);
+          }
           next_host_event_index_ = 0;
         }
         else {
           FlushHostBuffer();
         }
       }
-      return &(host_event_buffer_[current_host_event_buffer_slice_][next_host_event_index_]);
+      HostEventRecord *rec = &(host_event_buffer_[current_host_event_buffer_slice_][next_host_event_index_]);
+      rec->fn_ = nullptr;	// only set for events named after functions
+      return rec;
     }
 
     void BufferHostEvent(void) {
+      if (finalized_.load(std::memory_order_acquire)) {
+        // finalized between IsFinalized() and here, the event would never be flushed
+        ReleaseHostEvent(host_event_buffer_[current_host_event_buffer_slice_][next_host_event_index_]);
+        return;
+      }
       if (flush_immediately_) {
         std::lock_guard<std::recursive_mutex> lock(logger_lock_);
         FlushHostEvent(host_event_buffer_[current_host_event_buffer_slice_][next_host_event_index_]);
@@ -277,7 +396,62 @@ class TraceBuffer {
     uint32_t GetTid() { return tid_; }
     uint32_t GetPid() { return pid_; }
 
+    // The name of the thread is logged once per buffer, and again only if it changes
+    bool SetThreadName(const char *name) {
+      if (thread_name_ == name) {
+        return false;
+      }
+      thread_name_ = name;
+      return true;
+    }
+
+    // Where the flow arrow of a relation starts and ends. The arrow leaves the source task at the latest
+    // point not after the sink task begins, so a dependency points from the end of the task and a parent
+    // points from where the child begins.
+    bool ResolveRelation(HostEventRecord& rec, uint32_t& from_tid, uint64_t& from_ts, uint32_t& to_tid, uint64_t& to_ts) {
+      uint64_t from_start, from_end, to_end;
+      if ((itt_task_lookup_ == nullptr) ||
+          !itt_task_lookup_(rec.relation_args_.from_task_, from_tid, from_start, from_end) ||
+          !itt_task_lookup_(rec.relation_args_.to_task_, to_tid, to_ts, to_end)) {
+        return false;
+      }
+      uint64_t from_last = (from_end > from_start) ? (from_end - 1) : std::max(from_start, to_ts);
+      from_ts = std::min(std::max(to_ts, from_start), from_last);
+      return true;
+    }
+
+    // "<domain>::<function>"
+    static std::string GetFunctionEventName(const HostEventRecord& rec) {
+      std::string name = std::string(rec.fn_domain_) + "::";
+      if (itt_symbol_lookup_ != nullptr) {
+        return name + itt_symbol_lookup_(rec.fn_, rec.start_time_);
+      }
+      char str[32];
+      snprintf(str, sizeof(str), "0x%llx", (unsigned long long)rec.fn_);
+      return name + str;
+    }
+
+    std::string StringifyRelation(HostEventRecord& rec) {
+      uint32_t from_tid, to_tid;
+      uint64_t from_ts, to_ts;
+      if (!ResolveRelation(rec, from_tid, from_ts, to_tid, to_ts)) {
+        return "";	// one of the tasks never began or began after the trace was written
+      }
+
+      std::string name = std::string(", \"name\": \"") + rec.relation_args_.relation_ + "\", \"cat\": \"cpu_op\"";
+      std::string id = ", \"id\": " + std::to_string(rec.id_);
+      std::string str = ",\n{\"ph\": \"s\", \"tid\": " + std::to_string(from_tid) + ", \"pid\": " + std::to_string(pid_);
+      str += name + ", \"ts\": " + std::to_string(UniTimer::GetEpochTimeInUs(from_ts)) + id + "}";
+      str += ",\n{\"ph\": \"f\", \"bp\": \"e\", \"tid\": " + std::to_string(to_tid) + ", \"pid\": " + std::to_string(pid_);
+      str += name + ", \"ts\": " + std::to_string(UniTimer::GetEpochTimeInUs(to_ts)) + id + "}";
+      return str;
+    }
+
     std::string StringifyHostEvent(HostEventRecord& rec) {
+      if (rec.type_ == EVENT_RELATION) {
+        return StringifyRelation(rec);
+      }
+
       std::string str = ",\n{";  // header
 
       if (rec.type_ == EVENT_COMPLETE) {
@@ -292,13 +466,38 @@ class TraceBuffer {
         str += "\"ph\": \"t\"";
       } else if (rec.type_ == EVENT_MARK) {
         str += "\"ph\": \"R\"";
+      } else if (rec.type_ == EVENT_COUNTER) {
+        str += "\"ph\": \"C\"";
+      } else if (rec.type_ == EVENT_THREAD_NAME) {
+        str += "\"ph\": \"M\"";
+      } else if (rec.type_ == EVENT_ASYNC_START) {
+        str += "\"ph\": \"b\"";
+      } else if (rec.type_ == EVENT_ASYNC_END) {
+        str += "\"ph\": \"e\"";
+      } else if (rec.type_ == EVENT_INSTANT_THREAD) {
+        str += "\"ph\": \"i\", \"s\": \"t\"";
+      } else if (rec.type_ == EVENT_INSTANT_PROCESS) {
+        str += "\"ph\": \"i\", \"s\": \"p\"";
+      } else if (rec.type_ == EVENT_INSTANT_GLOBAL) {
+        str += "\"ph\": \"i\", \"s\": \"g\"";
       } else {
         // should never get here
       }
 
-      str += ", \"tid\": " + std::to_string(tid_);
+      str += ", \"tid\": " + std::to_string((rec.tid_ != 0) ? rec.tid_ : tid_);
       str += ", \"pid\": " + std::to_string(pid_);
 
+      if (rec.type_ == EVENT_THREAD_NAME) {
+        str += ", \"name\": \"thread_name\", \"args\": {\"name\": \"" + std::string(rec.name_) + "\"}}";
+        free(rec.name_);
+        rec.name_ = nullptr;
+        if (rec.id_ != 0) {
+          str += ",\n{\"ph\": \"M\", \"tid\": " + std::to_string((rec.tid_ != 0) ? rec.tid_ : tid_) + ", \"pid\": " + std::to_string(pid_);
+          str += ", \"name\": \"thread_sort_index\", \"args\": {\"sort_index\": " + std::to_string(rec.id_) + "}}";
+        }
+        return str;
+      }
+
       if (rec.type_ == EVENT_FLOW_SOURCE) {
         str += ", \"name\": \"dep\"";
         str += ", \"cat\": \"Flow_H2D_" + std::to_string(rec.id_) + "\"";
@@ -313,6 +512,8 @@ class TraceBuffer {
           } else {
             str += ", \"name\": \"" + std::string(rec.name_) + "\"";
           }
+        } else if (rec.fn_ != nullptr) {
+          str += ", \"name\": \"" + GetFunctionEventName(rec) + "\"";
         } else {
           // if ((rec.api_id_ != XptiTracingId) && (rec.api_id_ != IttTracingId)) {
           //   //str += ", \"name\": \"" + get_symbol(rec.api_id_) + "\"";
@@ -334,11 +535,33 @@ class TraceBuffer {
         str += ", \"dur\": " + std::to_string(UniTimer::GetTimeInUs(rec.end_time_ - rec.start_time_));
       }
 
+      std::string str_args = StringifyHostEventArgs(rec);
+
+      if (!str_args.empty()) {
+        str += ", \"args\": {" + str_args + "}";
+      }
+      if (str_args.empty() || (rec.type_ == EVENT_ASYNC_START) || (rec.type_ == EVENT_ASYNC_END)) {
+        // async events are matched by id
+        str += ", \"id\": " + std::to_string(rec.id_);
+      }
+
+      // end
+      str += "}";  // footer
+
+      return str;
+    }
+
+    std::string StringifyHostEventArgs(HostEventRecord& rec) {
       std::string str_args = "";  // build arguments
       if (rec.api_type_ == API_TYPE_ITT) {
-        str_args = str_args + "\"" + rec.itt_args_.key + "\":[";
-        str_args += convertDataToString(&rec.itt_args_);
-        str_args += "]";
+        if (rec.type_ == EVENT_COUNTER) {
+          // counter values are plain numbers, not arrays
+          str_args = str_args + "\"" + rec.itt_args_.key + "\":" + convertDataToString(&rec.itt_args_);
+        } else {
+          str_args = str_args + "\"" + rec.itt_args_.key + "\":[";
+          str_args += convertDataToString(&rec.itt_args_);
+          str_args += "]";
+        }
         if (rec.itt_args_.isIndirectData) {
           free(rec.itt_args_.data[0]);
         }
@@ -355,22 +578,131 @@ class TraceBuffer {
         // reset count to 0 and type to API_TYPE_NONE
         rec.itt_args_.count = 0;
         rec.api_type_ = API_TYPE_NONE;
+      } else if (rec.api_type_ == API_TYPE_MPI) {
+        if (rec.mpi_args_.is_tagged) {
+          str_args += "\"src_size\": " + std::to_string(rec.mpi_args_.src_size);
+          str_args += ", \"src_rank\": " + std::to_string(rec.mpi_args_.src_location);
+          str_args += ", \"src_tag\": " + std::to_string(rec.mpi_args_.src_tag);
+          str_args += ", \"dst_size\": " + std::to_string(rec.mpi_args_.dst_size);
+          str_args += ", \"dst_rank\": " + std::to_string(rec.mpi_args_.dst_location);
+          str_args += ", \"dst_tag\": " + std::to_string(rec.mpi_args_.dst_tag);
+        } else {
+          str_args += "\"mpi_counter\": " + std::to_string(rec.mpi_args_.mpi_counter);
+          str_args += ", \"src_size\": " + std::to_string(rec.mpi_args_.src_size);
+          str_args += ", \"dst_size\": " + std::to_string(rec.mpi_args_.dst_size);
+        }
+        IttArgs* args = rec.mpi_args_.itt_args;
+        for (IttArgs* arg = args; arg != nullptr; arg = arg->next) {
+          str_args = str_args + ", \"" + arg->key + "\":[";
+          str_args += convertDataToString(arg);
+          str_args += "]";
+        }
+        if (args != nullptr) {
+          ReleaseIttArgs(args);
+          free(args);
+        }
+        rec.api_type_ = API_TYPE_NONE;
       }
+      return str_args;
+    }
 
-      if (!str_args.empty()) {
-        str += ", \"args\": {" + str_args + "}";
-      } else {
-        str += ", \"id\": " + std::to_string(rec.id_);
+    void FlushHostEvent(HostEventRecord& rec) {
+      if (shm_publisher_ != nullptr) {
+        PublishHostEvent(rec);
+        return;
       }
+      logger_->Log(StringifyHostEvent(rec));
+    }
 
-      // end
-      str += "}";  // footer
+    // Copy the event into this thread's shared-memory ring. The collector does the rest.
+    void PublishHostEvent(HostEventRecord& rec) {
+      if (shm_ring_ == nullptr) {
+        shm_ring_ = shm_publisher_->AcquireRing(tid_);
+      }
+      if (rec.type_ == EVENT_RELATION) {
+        PublishRelation(rec);
+        return;
+      }
+      if (shm_ring_ == nullptr) {
+        StringifyHostEvent(rec);	// drop the event but release what it holds
+        return;
+      }
 
-      return str;
+      ShmEventRecord header;
+      header.id_ = rec.id_;
+      header.start_time_ = rec.start_time_;
+      header.end_time_ = rec.end_time_;
+      header.tid_ = rec.tid_;
+      switch (rec.type_) {
+        case EVENT_COMPLETE: header.phase_ = 'X'; break;
+        case EVENT_DURATION_START: header.phase_ = 'B'; break;
+        case EVENT_DURATION_END: header.phase_ = 'E'; break;
+        case EVENT_FLOW_SOURCE: header.phase_ = 's'; break;
+        case EVENT_FLOW_SINK: header.phase_ = 't'; break;
+        case EVENT_MARK: header.phase_ = 'R'; break;
+        case EVENT_COUNTER: header.phase_ = 'C'; break;
+        case EVENT_THREAD_NAME: header.phase_ = 'M'; break;
+        case EVENT_ASYNC_START: header.phase_ = 'b'; break;
+        case EVENT_ASYNC_END: header.phase_ = 'e'; break;
+        case EVENT_INSTANT_THREAD: header.phase_ = 'i'; break;
+        case EVENT_INSTANT_PROCESS: header.phase_ = 'i'; break;
+        case EVENT_INSTANT_GLOBAL: header.phase_ = 'i'; break;
+        default: header.phase_ = 'X'; break;
+      }
+      header.scope_ = (rec.type_ == EVENT_INSTANT_GLOBAL) ? 'g' : ((rec.type_ == EVENT_INSTANT_THREAD) ? 't' : 'p');
+      if (rec.type_ == EVENT_THREAD_NAME) {
+        std::string args = "\"name\": \"" + std::string(rec.name_) + "\"";
+        free(rec.name_);
+        rec.name_ = nullptr;
+        if (shm_ring_->Publish(header, "thread_name", args) && (rec.id_ != 0)) {
+          header.id_ = 0;
+          shm_ring_->Publish(header, "thread_sort_index", "\"sort_index\": " + std::to_string(rec.id_));
+        }
+        return;
+      }
+
+      std::string name;
+      if ((rec.name_ != nullptr) && (rec.type_ != EVENT_FLOW_SOURCE) && (rec.type_ != EVENT_FLOW_SINK)) {
+        name = rec.name_;
+        free(rec.name_);
+        rec.name_ = nullptr;
+      } else if (rec.fn_ != nullptr) {
+        name = GetFunctionEventName(rec);
+      } else {
+        // flows between host and device are named by the collector
+        if (rec.name_ != nullptr) {
+          free(rec.name_);
+          rec.name_ = nullptr;
+        }
+      }
+      shm_ring_->Publish(header, name, StringifyHostEventArgs(rec));
     }
 
-    void FlushHostEvent(HostEventRecord& rec) {
-      logger_->Log(StringifyHostEvent(rec));
+    void PublishRelation(HostEventRecord& rec) {
+      uint32_t from_tid, to_tid;
+      uint64_t from_ts, to_ts;
+      if ((shm_ring_ == nullptr) || !ResolveRelation(rec, from_tid, from_ts, to_tid, to_ts)) {
+        return;
+      }
+      ShmEventRecord header;
+      header.id_ = rec.id_;
+      header.scope_ = 'p';
+      for (int i = 0; i < 2; i++) {
+        header.phase_ = (i == 0) ? 's' : 'f';
+        header.tid_ = (i == 0) ? from_tid : to_tid;
+        header.start_time_ = (i == 0) ? from_ts : to_ts;
+        header.end_time_ = header.start_time_;
+        if (!shm_ring_->Publish(header, rec.relation_args_.relation_, std::string())) {
+          return;
+        }
+      }
+    }
+
+    void ReleaseRing() {
+      if (shm_ring_ != nullptr) {
+        delete shm_ring_;
+        shm_ring_ = nullptr;
+      }
     }
 
     void FlushHostBuffer() {
@@ -392,20 +724,48 @@ class TraceBuffer {
       host_event_buffer_flushed_ = true;
     }
 
+    void DiscardHostBuffer() {
+      if (host_event_buffer_flushed_) {
+        return;
+      }
+
+      for (int i = 0; i < current_host_event_buffer_slice_; i++) {
+        for (int j = 0; j < slice_capacity_; j++) {
+          ReleaseHostEvent(host_event_buffer_[i][j]);
+        }
+      }
+      for (int j = 0; j < next_host_event_index_; j++) {
+        ReleaseHostEvent(host_event_buffer_[current_host_event_buffer_slice_][j]);
+      }
+      current_host_event_buffer_slice_ = 0;
+      next_host_event_index_ = 0;
+      host_event_buffer_flushed_ = true;
+    }
+
+    // Free what an event holds without writing it
+    void ReleaseHostEvent(HostEventRecord& rec) {
+      if (rec.name_ != nullptr) {
+        free(rec.name_);
+        rec.name_ = nullptr;
+      }
+      if (rec.api_type_ == API_TYPE_ITT) {
+        ReleaseIttArgs(&rec.itt_args_);
+        rec.api_type_ = API_TYPE_NONE;
+      } else if (rec.api_type_ == API_TYPE_MPI) {
+        if (rec.mpi_args_.itt_args != nullptr) {
+          ReleaseIttArgs(rec.mpi_args_.itt_args);
+          free(rec.mpi_args_.itt_args);
+        }
+        rec.api_type_ = API_TYPE_NONE;
+      }
+    }
+
+
     void Finalize() {
       std::lock_guard<std::recursive_mutex> lock(logger_lock_);
       if (!finalized_.exchange(true)) {
-        if (!host_event_buffer_flushed_) {
-          for (int i = 0; i < current_host_event_buffer_slice_; i++) {
-            for (int j = 0; j < slice_capacity_; j++) {
-              FlushHostEvent(host_event_buffer_[i][j]);
-            }
-          }
-          for (int j = 0; j < next_host_event_index_; j++) {
-            FlushHostEvent(host_event_buffer_[current_host_event_buffer_slice_][j]);
-          }
-          host_event_buffer_flushed_ = true;
-        }
+        FlushHostBuffer();
+        ReleaseRing();
       }
     }
 
@@ -414,20 +774,92 @@ class TraceBuffer {
     }
 
   private:
+    TraceBuffer() : state_(TRACE_BUFFER_IN_USE), finalized_(false) {
+      const TraceBufferConfig& config = TraceBufferConfig::Get();
+      buffer_capacity_ = config.buffer_capacity_;
+      slice_capacity_ = config.slice_capacity_;
+      flush_immediately_ = config.flush_immediately_;
+      metrics_enabled_ = config.metrics_enabled_;
+
+      HostEventRecord *her = (HostEventRecord *)(malloc(sizeof(HostEventRecord) * slice_capacity_));
+      UniMemory::ExitIfOutOfMemory((void *)(her));
+      host_event_buffer_.push_back(her);
+    }
+
+    // Slices of a recycled buffer are kept and reused. A buffer taken after FinalizeAll() is
+    // finalized from the start, so nothing is buffered that would never be flushed.
+    void Reset(void) {
+      tid_= utils::GetTid();
+      pid_= utils::GetPid();
+      thread_name_.clear();
+      current_host_event_buffer_slice_ = 0;
+      next_host_event_index_ = 0;
+      host_event_buffer_flushed_ = true;
+      finalized_.store(trace_buffers_finalized_.load(std::memory_order_seq_cst), std::memory_order_release);
+    }
+
     int32_t buffer_capacity_;
     int32_t slice_capacity_;	// each buffer can have multiple slices
     int32_t current_host_event_buffer_slice_;	// host slice in use
     int32_t next_host_event_index_;	// next free host event in in-use slice
     uint32_t tid_;
     uint32_t pid_;
+    std::string thread_name_;	// last name logged with __itt_thread_set_name()
     std::vector<HostEventRecord *> host_event_buffer_;
     bool flush_immediately_;
     bool host_event_buffer_flushed_;
+    std::atomic<uint32_t> state_;
     std::atomic<bool> finalized_;
     bool metrics_enabled_;
+    ShmRingWriter *shm_ring_ = nullptr;
+    TraceBuffer *next_ = nullptr;	// next in trace_buffers_
+};
+
+// Thread-local handle of a TraceBuffer. Constructing it costs nothing and the buffer is only
+// taken when the thread logs its first event.
+class TraceBufferHandle {
+  public:
+    ~TraceBufferHandle() {
+      if (buffer_ != nullptr) {
+        buffer_->Retire();
+      }
+    }
+
+    bool IsFinalized() {
+      if (buffer_ == nullptr) {
+        return trace_buffers_finalized_.load(std::memory_order_acquire);
+      }
+      return buffer_->IsFinalized();
+    }
+
+    HostEventRecord *GetHostEvent(void) {
+      if (buffer_ == nullptr) {
+        buffer_ = TraceBuffer::Acquire();
+      }
+      return buffer_->GetHostEvent();
+    }
+
+    void BufferHostEvent(void) {
+      buffer_->BufferHostEvent();
+    }
+
+    bool SetThreadName(const char *name) {
+      if (buffer_ == nullptr) {
+        buffer_ = TraceBuffer::Acquire();
+      }
+      return buffer_->SetThreadName(name);
+    }
+
+    // In the child after fork(). The buffer belongs to the parent and a new one is taken on the next event.
+    void ForgetAfterFork(void) {
+      buffer_ = nullptr;
+    }
+
+  private:
+    TraceBuffer *buffer_ = nullptr;
 };
 
-thread_local TraceBuffer thread_local_buffer_;
+thread_local TraceBufferHandle thread_local_buffer_;
 
 class ChromeLogger {
   private:
@@ -437,17 +869,13 @@ class ChromeLogger {
     std::set<std::string> filter_strings_set_;
     std::string process_name_;
     std::string chrome_trace_file_name_;
+    std::string staged_trace_file_name_;	// same as chrome_trace_file_name_ if neither staging nor container is on
     std::iostream::pos_type data_start_pos_;
     uint64_t process_start_time_;
+    inline static ChromeLogger *forked_logger_ = nullptr;	// logger of a forked child, see ChildAfterFork()
 
     ChromeLogger(const TraceOptions& options, const char* filename) : options_(options) {
-      process_start_time_ = UniTimer::GetEpochTimeInUs(UniTimer::GetHostTimestamp());
       process_name_ = filename;
-      chrome_trace_file_name_ = TraceOptions::GetChromeTraceFileName(filename);
-      if (this->CheckOption(TRACE_OUTPUT_DIR_PATH)) {
-          std::string dir = utils::GetEnv("UNITRACE_TraceOutputDir");
-          chrome_trace_file_name_ = (dir + '/' + chrome_trace_file_name_);
-      }
 
       if (this->CheckOption(TRACE_KERNEL_NAME_FILTER)) {
         if (this->CheckOption(TRACE_K_NAME_FILTER_IN)) {
@@ -472,14 +900,26 @@ class ChromeLogger {
         filtering_on_ = false;
         filter_strings_set_.insert("ALL");
       }
-      logger_ = new Logger(chrome_trace_file_name_.c_str(), true, true);
-      UniMemory::ExitIfOutOfMemory((void *)(logger_));
 
-      logger_->Log("{ \"traceEvents\":[\n");
+      Open();
+    }
 
-      std::string str("{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": ");
+    // Open the trace of the current process. The file name has the pid in it, so a forked child gets its own.
+    void Open(void) {
+      process_start_time_ = UniTimer::GetEpochTimeInUs(UniTimer::GetHostTimestamp());
+      chrome_trace_file_name_ = TraceOptions::GetChromeTraceFileName(process_name_.c_str());
+      if (this->CheckOption(TRACE_OUTPUT_DIR_PATH)) {
+          std::string dir = utils::GetEnv("UNITRACE_TraceOutputDir");
+          chrome_trace_file_name_ = (dir + '/' + chrome_trace_file_name_);
+      }
 
-      str += std::to_string(utils::GetPid()) + ", \"ts\": " + std::to_string(process_start_time_) + ", \"args\": {\"name\": \"";
+      if (UniContainer::IsContainerEnabled()) {
+        staged_trace_file_name_ = UniContainer::GetPrivateFileName(chrome_trace_file_name_);
+      } else if (UniStaging::IsStagingEnabled()) {
+        staged_trace_file_name_ = UniStaging::GetStagedFileName(chrome_trace_file_name_);
+      } else {
+        staged_trace_file_name_ = chrome_trace_file_name_;
+      }
 
       std::string host = GetHostName();
       std::string rank_str = utils::GetEnv("PMI_RANK"); // Simplified from original
@@ -487,6 +927,24 @@ class ChromeLogger {
           rank_str = utils::GetEnv("PMIX_RANK");
       }
 
+      if (!utils::GetEnv("UNITRACE_ShmSession").empty()) {
+        shm_publisher_ = ShmPublisher::Create(chrome_trace_file_name_, process_name_, rank_str, host,
+                                              UniTimer::GetEpochTime(0), process_start_time_);
+        if (shm_publisher_ != nullptr) {
+          // the collector writes the trace file
+          return;
+        }
+      }
+
+      logger_ = new Logger(staged_trace_file_name_.c_str(), true, true);
+      UniMemory::ExitIfOutOfMemory((void *)(logger_));
+
+      logger_->Log("{ \"traceEvents\":[\n");
+
+      std::string str("{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": ");
+
+      str += std::to_string(utils::GetPid()) + ", \"ts\": " + std::to_string(process_start_time_) + ", \"args\": {\"name\": \"";
+
       if (rank_str.empty()) {
         str += "HOST<" + host + ">\"}}";
       }
@@ -499,19 +957,65 @@ class ChromeLogger {
       data_start_pos_ = logger_->GetLogFilePosition();
     }
 
+    // In a forked child: drop the buffers, the ring session and the file of the parent without writing anything
+    void ReleaseParentTrace(void) {
+      TraceBuffer::DiscardAllAfterFork();
+
+      if (shm_publisher_ != nullptr) {
+        shm_publisher_->Detach();
+        delete shm_publisher_;
+        shm_publisher_ = nullptr;
+      }
+      if (logger_ != nullptr) {
+        delete logger_;	// closes the child's descriptor, nothing is left to write
+        logger_ = nullptr;
+      }
+    }
+
+    static void OpenAfterFork(void) {
+      forked_logger_->ReleaseParentTrace();
+      forked_logger_->Open();
+    }
+
+    static void ReleaseAfterFork(void) {
+      forked_logger_->ReleaseParentTrace();
+    }
+
+    // Members of the "metadata" object of the trace, as many as fit in max_size
+    static std::string GetProcessMetadata(size_t max_size) {
+      std::lock_guard<std::recursive_mutex> lock(logger_lock_);
+      std::string str;
+      for (auto& value : process_metadata_) {
+        std::string member = (str.empty() ? "\"" : ", \"") + value.first + "\": " + value.second;
+        if (str.size() + member.size() <= max_size) {
+          str += member;
+        }
+      }
+      return str;
+    }
+
   public:
     ChromeLogger(const ChromeLogger& that) = delete;
     ChromeLogger& operator=(const ChromeLogger& that) = delete;
 
     ~ChromeLogger() {
+      if (trace_open_pending_.exchange(nullptr, std::memory_order_acq_rel) != nullptr) {
+        ReleaseParentTrace();	// a forked child that logged no event has no trace of its own
+      }
+
+      if (shm_publisher_ != nullptr) {
+        logger_lock_.lock();
+        TraceBuffer::FinalizeAll();
+        shm_publisher_->SetMetadata(GetProcessMetadata(SHM_METADATA_SIZE - 1));
+        delete shm_publisher_;
+        shm_publisher_ = nullptr;
+        logger_lock_.unlock();
+        return;
+      }
+
       if (logger_ != nullptr) {
         logger_lock_.lock();
-        if (trace_buffers_) {
-          for (auto it = trace_buffers_->begin(); it != trace_buffers_->end();) {
-            (*it)->Finalize();
-            it = trace_buffers_->erase(it);
-          }
-        }
+        TraceBuffer::FinalizeAll();
 
         logger_lock_.unlock();
 
@@ -519,16 +1023,22 @@ class ChromeLogger {
           // no data has been logged
           // remove the log file, but close it first
           delete logger_;
-          if (std::remove(chrome_trace_file_name_.c_str()) == 0) {
+          if (std::remove(staged_trace_file_name_.c_str()) == 0) {
             std::cerr << "[INFO] No event of interest is logged for process " << utils::GetPid() << " (" << process_name_ << ")" << std::endl;
           } else {
-            std::cerr << "[INFO] No event of interest is logged for process " << utils::GetPid() << " (" << process_name_ << ") in file " << chrome_trace_file_name_ << std::endl;
+            std::cerr << "[INFO] No event of interest is logged for process " << utils::GetPid() << " (" << process_name_ << ") in file " << staged_trace_file_name_ << std::endl;
           }
         } else {
-          std::string str = "\n]\n}\n";
-          logger_->Log(str);
+          logger_->Log(GetTraceFileFooter(GetProcessMetadata(std::string::npos)));
           delete logger_;
-          std::cerr << "[INFO] Timeline is stored in " << chrome_trace_file_name_ << std::endl;
+          if (UniContainer::IsContainerEnabled() && UniContainer::AppendFile(staged_trace_file_name_, chrome_trace_file_name_)) {
+            std::cerr << "[INFO] Timeline is stored in " << UniContainer::GetContainerFileName(chrome_trace_file_name_)
+                      << " as " << chrome_trace_file_name_.substr(chrome_trace_file_name_.find_last_of('/') + 1) << std::endl;
+          } else if (UniStaging::MigrateFile(staged_trace_file_name_, chrome_trace_file_name_)) {
+            std::cerr << "[INFO] Timeline is stored in " << chrome_trace_file_name_ << std::endl;
+          } else {
+            std::cerr << "[INFO] Timeline is stored in " << staged_trace_file_name_ << std::endl;
+          }
         }
       }
     }
@@ -543,6 +1053,38 @@ class ChromeLogger {
       return options_.CheckFlag(option);
     }
 
+    // pthread_atfork() handlers, see tracer.cc
+    // No event is being written while the lock is held, and the stream buffer is empty so the child
+    // does not inherit half-written data of the parent.
+    void PrepareFork(void) {
+      logger_lock_.lock();
+      if (logger_ != nullptr) {
+        logger_->Flush();
+      }
+    }
+
+    void ParentAfterFork(void) {
+      logger_lock_.unlock();
+    }
+
+    // Only the forking thread exists in the child. Nothing but the lock is touched here: a child
+    // that goes on to exec() must not write a trace. The trace inherited from the parent is dropped
+    // without being written when the child logs its first event, and the child's own trace is
+    // opened then, unless child processes are not to be followed.
+    void ChildAfterFork(bool follow) {
+      new (&logger_lock_) std::recursive_mutex();	// the lock is owned by the parent's thread id
+
+      thread_local_buffer_.ForgetAfterFork();
+
+      forked_logger_ = this;
+      if (follow) {
+        trace_open_pending_.store(OpenAfterFork, std::memory_order_release);
+      } else {
+        trace_buffers_finalized_.store(true, std::memory_order_release);
+        trace_open_pending_.store(ReleaseAfterFork, std::memory_order_release);
+      }
+    }
+
   /* static void XptiLoggingCallback(EVENT_TYPE etype, const char *name, uint64_t start_ts, uint64_t end_ts) {
       if (!thread_local_buffer_.IsFinalized()) {
         HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
@@ -566,6 +1108,11 @@ class ChromeLogger {
       }*/
 
     static void IttLoggingCallback(const char *name, uint64_t start_ts, uint64_t end_ts, IttArgs* metadata_args) {
+      IttTrackSliceLoggingCallback(0, name, start_ts, end_ts, metadata_args);
+    }
+
+    // Complete event on a virtual track, or on the calling thread if tid is 0
+    static void IttTrackSliceLoggingCallback(uint32_t tid, const char *name, uint64_t start_ts, uint64_t end_ts, IttArgs* metadata_args) {
       if (!thread_local_buffer_.IsFinalized()) {
         HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
 
@@ -581,6 +1128,7 @@ class ChromeLogger {
         rec->start_time_ = start_ts;
         rec->end_time_ = end_ts;
         rec->id_ = 0;
+        rec->tid_ = tid;
         if ((metadata_args != nullptr) && (metadata_args->count != 0)) {
           rec->api_type_ = API_TYPE_ITT;
           rec->itt_args_ = *metadata_args;
@@ -595,6 +1143,264 @@ class ChromeLogger {
       }
     }
 
+    // MPI events on a virtual track, or on the calling thread if tid is 0
+    static void MpiLoggingCallback(uint32_t tid, const char *name, uint64_t start_ts, uint64_t end_ts, size_t src_size, int src_location, int src_tag,
+                                   size_t dst_size, int dst_location, int dst_tag, IttArgs* metadata_args) {
+      if (thread_local_buffer_.IsFinalized()) {
+        ReleaseIttArgs(metadata_args);
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = EVENT_COMPLETE;
+      rec->name_ = strdup(name);
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = start_ts;
+      rec->end_time_ = end_ts;
+      rec->id_ = 0;
+      rec->tid_ = tid;
+      rec->api_type_ = API_TYPE_MPI;
+      rec->mpi_args_.src_size = src_size;
+      rec->mpi_args_.src_location = src_location;
+      rec->mpi_args_.src_tag = src_tag;
+      rec->mpi_args_.dst_size = dst_size;
+      rec->mpi_args_.dst_location = dst_location;
+      rec->mpi_args_.dst_tag = dst_tag;
+      rec->mpi_args_.mpi_counter = 0;
+      rec->mpi_args_.is_tagged = true;
+      rec->mpi_args_.itt_args = MoveIttArgs(metadata_args);
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
+    static void MpiInternalLoggingCallback(uint32_t tid, const char *name, uint64_t start_ts, uint64_t end_ts, int64_t mpi_counter, size_t src_size, size_t dst_size,
+                                           IttArgs* metadata_args) {
+      if (thread_local_buffer_.IsFinalized()) {
+        ReleaseIttArgs(metadata_args);
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = EVENT_COMPLETE;
+      rec->name_ = strdup(name);
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = start_ts;
+      rec->end_time_ = end_ts;
+      rec->id_ = 0;
+      rec->tid_ = tid;
+      rec->api_type_ = API_TYPE_MPI;
+      rec->mpi_args_.src_size = src_size;
+      rec->mpi_args_.src_location = -1;
+      rec->mpi_args_.src_tag = 0;
+      rec->mpi_args_.dst_size = dst_size;
+      rec->mpi_args_.dst_location = -1;
+      rec->mpi_args_.dst_tag = 0;
+      rec->mpi_args_.mpi_counter = mpi_counter;
+      rec->mpi_args_.is_tagged = false;
+      rec->mpi_args_.itt_args = MoveIttArgs(metadata_args);
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
+    // Complete event of a task of __itt_task_begin_fn(), named when it is written
+    static void IttFunctionSliceLoggingCallback(uint32_t tid, const char *domain, const void *fn, uint64_t start_ts, uint64_t end_ts, IttArgs* metadata_args) {
+      if (thread_local_buffer_.IsFinalized()) {
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = EVENT_COMPLETE;
+      rec->name_ = nullptr;
+      rec->fn_ = fn;
+      rec->fn_domain_ = domain;
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = start_ts;
+      rec->end_time_ = end_ts;
+      rec->id_ = 0;
+      rec->tid_ = tid;
+      if ((metadata_args != nullptr) && (metadata_args->count != 0)) {
+        rec->api_type_ = API_TYPE_ITT;
+        rec->itt_args_ = *metadata_args;
+      }
+      else {
+        rec->api_type_ = API_TYPE_NONE;
+        rec->itt_args_.count = 0;
+      }
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
+    static void IttCounterLoggingCallback(const char *name, uint64_t ts, IttArgs* value) {
+      if (thread_local_buffer_.IsFinalized()) {
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = EVENT_COUNTER;
+      rec->name_ = strdup(name);
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = ts;
+      rec->end_time_ = ts;
+      rec->id_ = 0;
+      rec->tid_ = 0;
+      rec->api_type_ = API_TYPE_ITT;
+      rec->itt_args_ = *value;	// single value stored in place
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
+    static void IttMarkLoggingCallback(uint32_t tid, const char *name, uint64_t ts, bool global, IttArgs* metadata_args) {
+      if (thread_local_buffer_.IsFinalized()) {
+        if (metadata_args->isIndirectData) {
+          free(metadata_args->data[0]);
+        }
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = global ? EVENT_INSTANT_GLOBAL : EVENT_INSTANT_PROCESS;
+      rec->name_ = strdup(name);
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = ts;
+      rec->end_time_ = ts;
+      rec->id_ = 0;
+      rec->tid_ = tid;
+      if (metadata_args->count != 0) {
+        rec->api_type_ = API_TYPE_ITT;
+        rec->itt_args_ = *metadata_args;
+      }
+      else {
+        rec->api_type_ = API_TYPE_NONE;
+        rec->itt_args_.count = 0;
+      }
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
+    static void IttThreadNameLoggingCallback(const char *name) {
+      if (thread_local_buffer_.IsFinalized() || !thread_local_buffer_.SetThreadName(name)) {
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = EVENT_THREAD_NAME;
+      rec->name_ = strdup(name);
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = UniTimer::GetHostTimestamp();
+      rec->end_time_ = rec->start_time_;
+      rec->id_ = 0;	// threads are not sorted
+      rec->tid_ = 0;
+      rec->api_type_ = API_TYPE_NONE;
+      rec->itt_args_.count = 0;
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
+    // Metadata of the process goes into the "metadata" object of the trace. Metadata of a thread or a
+    // virtual track is an instant event of it, named after the key.
+    static void IttMetadataLoggingCallback(uint32_t tid, bool process, IttArgs* metadata_args) {
+      if (thread_local_buffer_.IsFinalized()) {
+        if (metadata_args->isIndirectData) {
+          free(metadata_args->data[0]);
+        }
+        return;
+      }
+
+      if (process) {
+        std::string value = "[" + convertDataToString(metadata_args) + "]";
+        if (metadata_args->isIndirectData) {
+          free(metadata_args->data[0]);
+        }
+        std::lock_guard<std::recursive_mutex> lock(logger_lock_);
+        process_metadata_[metadata_args->key] = std::move(value);	// the last value of a key wins
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = EVENT_INSTANT_THREAD;
+      rec->name_ = strdup(metadata_args->key);
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = UniTimer::GetHostTimestamp();
+      rec->end_time_ = rec->start_time_;
+      rec->id_ = 0;
+      rec->tid_ = tid;
+      rec->api_type_ = API_TYPE_ITT;
+      rec->itt_args_ = *metadata_args;
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
+    static void IttAsyncLoggingCallback(const char *name, uint64_t id, uint64_t ts, bool begin) {
+      if (thread_local_buffer_.IsFinalized()) {
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = begin ? EVENT_ASYNC_START : EVENT_ASYNC_END;
+      rec->name_ = strdup(name);
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = ts;
+      rec->end_time_ = ts;
+      rec->id_ = id;
+      rec->tid_ = 0;
+      rec->api_type_ = API_TYPE_NONE;
+      rec->itt_args_.count = 0;
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
+    static void IttRelationLoggingCallback(uint64_t from_task, uint64_t to_task, const char *relation) {
+      static std::atomic<uint64_t> next_flow_id{1};
+
+      if (thread_local_buffer_.IsFinalized()) {
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = EVENT_RELATION;
+      rec->name_ = nullptr;
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = 0;
+      rec->end_time_ = 0;
+      rec->id_ = next_flow_id.fetch_add(1, std::memory_order_relaxed);
+      rec->tid_ = 0;
+      rec->api_type_ = API_TYPE_NONE;
+      rec->relation_args_.from_task_ = from_task;
+      rec->relation_args_.to_task_ = to_task;
+      rec->relation_args_.relation_ = relation;
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
+    static void IttTrackNameLoggingCallback(uint32_t tid, const char *name, uint32_t sort_index) {
+      if (thread_local_buffer_.IsFinalized()) {
+        return;
+      }
+
+      HostEventRecord *rec = thread_local_buffer_.GetHostEvent();
+
+      rec->type_ = EVENT_THREAD_NAME;
+      rec->name_ = strdup(name);
+      rec->api_id_ = IttTracingId;
+      rec->start_time_ = UniTimer::GetHostTimestamp();
+      rec->end_time_ = rec->start_time_;
+      rec->id_ = sort_index;	// 0 if the thread is not sorted
+      rec->tid_ = tid;
+      rec->api_type_ = API_TYPE_NONE;
+      rec->itt_args_.count = 0;
+
+      thread_local_buffer_.BufferHostEvent();
+    }
+
     static void ChromeCallLoggingCallback(std::vector<uint64_t> *kids, FLOW_DIR flow_dir, API_TRACING_ID api_id,
       uint64_t started, uint64_t ended) {
       if (thread_local_buffer_.IsFinalized()) {
@@ -609,6 +1415,7 @@ class ChromeLogger {
       rec->start_time_ = started;
       rec->end_time_ = ended;
       rec->id_ = 0;
+      rec->tid_ = 0;
       rec->name_ = nullptr;
       thread_local_buffer_.BufferHostEvent();
 
@@ -0,0 +1,120 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_CLOCK_H_
+#define PTI_TOOLS_UNITRACE_ITT_CLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
+#include "unitimer.h"
+#include "unimemory.h"
+#include "itt_utils.h"
+
+#define ITT_CLOCK_NS_PER_SECOND	1000000000ULL
+
+// Conversion of a user clock domain to the host clock.
+// host timestamp = host_base_ + (timestamp - clock_base_) * scale_
+struct IttClockConversion {
+  uint64_t clock_base_;
+  uint64_t host_base_;
+  double scale_;	// host nanoseconds per tick
+  bool identity_;	// ticks are host nanoseconds
+};
+
+// Conversion in use by a domain. A conversion is never changed once published: calibrating again
+// publishes a new one, so a thread converting a timestamp meanwhile uses either the old or the new
+// calibration but never a mix. Conversions are never freed, as a reader may still hold one.
+struct IttClockCalibration {
+  std::atomic<const IttClockConversion *> conversion_{nullptr};
+};
+
+// User clock domains.
+// The clock of a domain is read once when the domain is created or reset, and the host clock is
+// read at the same moment. Later timestamps of the domain are converted without reading any clock.
+// Timestamps without a clock domain are host timestamps, the same as __itt_get_timestamp() returns.
+class IttClockDomains : public IttForkHandlers<IttClockDomains> {
+  public:
+    static __itt_clock_domain *Create(__itt_get_clock_info_fn fn, void *fn_data) {
+      if (fn == nullptr) {
+        return nullptr;
+      }
+      ClockState& state = GetState();
+
+      __itt_clock_domain *domain = (__itt_clock_domain *)malloc(sizeof(__itt_clock_domain));
+      UniMemory::ExitIfOutOfMemory((void *)domain);
+      IttClockCalibration *calibration = new IttClockCalibration();
+      UniMemory::ExitIfOutOfMemory((void *)calibration);
+      domain->fn = fn;
+      domain->fn_data = fn_data;
+      domain->extra1 = 0;
+      domain->extra2 = calibration;
+
+      std::lock_guard<std::mutex> lock(state.lock_);
+      Calibrate(domain);
+      domain->next = state.domain_list_;
+      state.domain_list_ = domain;
+      return domain;
+    }
+
+    // Read all clocks again, e.g. after a user clock has been adjusted
+    static void Reset(void) {
+      ClockState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      for (__itt_clock_domain *domain = state.domain_list_; domain != nullptr; domain = domain->next) {
+        Calibrate(domain);
+      }
+    }
+
+    static uint64_t ToHostTimestamp(const __itt_clock_domain *domain, unsigned long long timestamp) {
+      if (timestamp == (unsigned long long)__itt_timestamp_none) {
+        return UniTimer::GetHostTimestamp();
+      }
+      if ((domain == nullptr) || (domain->extra2 == nullptr)) {
+        return timestamp;
+      }
+      const IttClockConversion *conversion = ((const IttClockCalibration *)domain->extra2)->conversion_.load(std::memory_order_acquire);
+      if (conversion->identity_) {
+        return conversion->host_base_ + (timestamp - conversion->clock_base_);
+      }
+      if (timestamp >= conversion->clock_base_) {
+        return conversion->host_base_ + (uint64_t)((timestamp - conversion->clock_base_) * conversion->scale_);
+      }
+      uint64_t before = (uint64_t)((conversion->clock_base_ - timestamp) * conversion->scale_);
+      return (before < conversion->host_base_) ? (conversion->host_base_ - before) : 0;
+    }
+
+  private:
+    friend class IttForkHandlers<IttClockDomains>;
+
+    struct ClockState {
+      std::mutex lock_;
+      __itt_clock_domain *domain_list_ = nullptr;
+    };
+
+    static ClockState& GetState(void) {
+      static ClockState *state = new ClockState();
+      return *state;
+    }
+
+    // lock is held
+    static void Calibrate(__itt_clock_domain *domain) {
+      IttClockConversion *conversion = new IttClockConversion();
+      UniMemory::ExitIfOutOfMemory((void *)conversion);
+      __itt_clock_info info = {0, 0};
+      domain->fn(&info, domain->fn_data);
+      conversion->host_base_ = UniTimer::GetHostTimestamp();
+      domain->info = info;
+      conversion->clock_base_ = info.clock_base;
+      conversion->identity_ = ((info.clock_freq == 0) || (info.clock_freq == ITT_CLOCK_NS_PER_SECOND));
+      conversion->scale_ = conversion->identity_ ? 1.0 : (double(ITT_CLOCK_NS_PER_SECOND) / double(info.clock_freq));
+      ((IttClockCalibration *)domain->extra2)->conversion_.store(conversion, std::memory_order_release);
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_CLOCK_H_
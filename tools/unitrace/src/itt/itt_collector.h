@@ -18,6 +18,7 @@
 #include <map>
 #include <set>
 #include <utility>
+#include <vector>
 #include "unitimer.h"
 #include "unimemory.h"
 
@@ -26,9 +27,12 @@
 
 static std::string rank_mpi = (utils::GetEnv("PMI_RANK").empty()) ? utils::GetEnv("PMIX_RANK") : utils::GetEnv("PMI_RANK");
 typedef void (*OnIttLoggingCallback)(const char *name, uint64_t start_ts, uint64_t end_ts, IttArgs* metadata_args);
-typedef void (*OnMpiLoggingCallback)(const char *name, uint64_t start_ts, uint64_t end_ts, size_t src_size, int src_location, int src_tag,
-                                     size_t dst_size, int dst_location, int dst_tag);
-typedef void (*OnMpiInternalLoggingCallback)(const char *name, uint64_t start_ts, uint64_t end_ts, int64_t mpi_counter, size_t src_size, size_t dst_size);
+typedef void (*OnMpiLoggingCallback)(uint32_t tid, const char *name, uint64_t start_ts, uint64_t end_ts, size_t src_size, int src_location, int src_tag,
+                                     size_t dst_size, int dst_location, int dst_tag, IttArgs* metadata_args);
+typedef void (*OnMpiInternalLoggingCallback)(uint32_t tid, const char *name, uint64_t start_ts, uint64_t end_ts, int64_t mpi_counter, size_t src_size, size_t dst_size,
+                                     IttArgs* metadata_args);
+typedef void (*OnIttMetadataLoggingCallback)(uint32_t tid, bool process, IttArgs* metadata_args);
+typedef void (*OnIttThreadNameLoggingCallback)(const char *name);
 
 struct ittFunction {
   uint64_t total_time;
@@ -55,6 +59,15 @@ using ittFunctionInfoMap = std::map<std::string, ittFunction>;
 ittFunctionInfoMap ccl_function_info_map;
 std::mutex lock_func_info;
 
+// Times of the tasks of __itt_task_begin_fn() by function. The functions are named when the summary is printed.
+struct ittFunctionTask {
+  ittFunction function;
+  uint64_t ts;	// start of the first task, to name the function in the modules loaded then
+};
+std::map<const void *, ittFunctionTask> ccl_function_task_map;	// protected by lock_func_info
+
+static const char *IttGetFunctionName(const void *fn, uint64_t ts);
+
 const size_t metadata_type_sizes[] = {
     1,                  // __itt_metadata_unknown
     sizeof(uint64_t),   // __itt_metadata_u64
@@ -67,21 +80,36 @@ const size_t metadata_type_sizes[] = {
     sizeof(double)      // __itt_metadata_double
 };
 
+static void AddTime(ittFunction& function, uint64_t time) {
+  function.total_time += time;
+  if (time < function.min_time) {
+    function.min_time = time;
+  }
+  if (time > function.max_time) {
+    function.max_time = time;
+  }
+  ++function.call_count;
+}
+
 void AddFunctionTime(const std::string& name, uint64_t time) {
   if (name.rfind("oneCCL::", 0) == 0) {
     const std::lock_guard<std::mutex> lock(lock_func_info);
     if (ccl_function_info_map.count(name) == 0) {
       ccl_function_info_map[name] = {time, time, time, 1};
     } else {
-      ittFunction& function = ccl_function_info_map[name];
-      function.total_time += time;
-      if (time < function.min_time) {
-        function.min_time = time;
-      }
-      if (time > function.max_time) {
-        function.max_time = time;
-      }
-      ++function.call_count;
+      AddTime(ccl_function_info_map[name], time);
+    }
+  }
+}
+
+void AddFunctionTime(const char *domain, const void *fn, uint64_t start, uint64_t time) {
+  if (strcmp(domain, "oneCCL") == 0) {
+    const std::lock_guard<std::mutex> lock(lock_func_info);
+    auto it = ccl_function_task_map.find(fn);
+    if (it == ccl_function_task_map.end()) {
+      ccl_function_task_map[fn] = {{time, time, time, 1}, start};
+    } else {
+      AddTime(it->second.function, time);
     }
   }
 }
@@ -105,6 +133,9 @@ class IttCollector {
   void EnableChromeLogging() { is_itt_chrome_logging_on_ = true;}
   bool IsEnableChromeLoggingOn() { return is_itt_chrome_logging_on_; }
 
+  void EnableMpiLogging() { is_itt_mpi_logging_on_ = true;}
+  bool IsMpiLoggingOn() { return is_itt_mpi_logging_on_; }
+
   ~IttCollector() {
   }
 
@@ -117,20 +148,56 @@ class IttCollector {
     }
   }
 
-  void Log(const char *name, uint64_t start_ts, uint64_t end_ts, size_t src_size, int src_location, int src_tag,
-                                     size_t dst_size, int dst_location, int dst_tag) {
+  // MPI events go to the virtual track tid, or to the calling thread if tid is 0. The arguments of the task are
+  // logged with the message.
+  void Log(uint32_t tid, const char *name, uint64_t start_ts, uint64_t end_ts, size_t src_size, int src_location, int src_tag,
+                                     size_t dst_size, int dst_location, int dst_tag, IttArgs* metadata_args) {
     if (mpi_callback_) {
-      mpi_callback_(name, start_ts, end_ts, src_size, src_location, src_tag,
-                                    dst_size, dst_location, dst_tag);
+      mpi_callback_(tid, name, start_ts, end_ts, src_size, src_location, src_tag,
+                                    dst_size, dst_location, dst_tag, metadata_args);
     }
   }
 
-  void Log(const char *name, uint64_t start_ts, uint64_t end_ts, int64_t mpi_counter, size_t src_size, size_t dst_size) {
+  void Log(uint32_t tid, const char *name, uint64_t start_ts, uint64_t end_ts, int64_t mpi_counter, size_t src_size, size_t dst_size,
+           IttArgs* metadata_args) {
     if (mpi_internal_callback_) {
-      mpi_internal_callback_(name, start_ts, end_ts, mpi_counter, src_size, dst_size);
+      mpi_internal_callback_(tid, name, start_ts, end_ts, mpi_counter, src_size, dst_size, metadata_args);
+    }
+  }
+
+  // Name of the calling thread
+  void LogThreadName(const char *name) {
+    if (thread_name_callback_) {
+      thread_name_callback_(name);
+    }
+  }
+
+  // Metadata of the process, or of the thread or virtual track tid (0 for the calling thread)
+  void LogMetadata(uint32_t tid, bool process, IttArgs* metadata_args) {
+    if (metadata_callback_) {
+      metadata_callback_(tid, process, metadata_args);
+    }
+    else if (metadata_args->isIndirectData) {
+      free(metadata_args->data[0]);
     }
   }
 
+  // pthread_atfork() handlers, see tracer.cc
+  void PrepareFork() {
+    lock_func_info.lock();
+  }
+
+  void ParentAfterFork() {
+    lock_func_info.unlock();
+  }
+
+  // The child reports its own calls only
+  void ChildAfterFork() {
+    new (&lock_func_info) std::mutex();
+    ccl_function_info_map.clear();
+    ccl_function_task_map.clear();
+  }
+
   void SetMpiCallback(OnMpiLoggingCallback callback) {
     mpi_callback_ = callback;
   }
@@ -139,19 +206,43 @@ class IttCollector {
     mpi_internal_callback_ = callback;
   }
 
+  void SetMetadataCallback(OnIttMetadataLoggingCallback callback) {
+    metadata_callback_ = callback;
+  }
+
+  void SetThreadNameCallback(OnIttThreadNameLoggingCallback callback) {
+    thread_name_callback_ = callback;
+  }
+
   std::string CclSummaryReport() const {
     const uint32_t kFunctionLength = 10;
     const uint32_t kCallsLength = 12;
     const uint32_t kTimeLength = 20;
     const uint32_t kPercentLength = 12;
 
-    if (ccl_function_info_map.empty()) {
+    if (ccl_function_info_map.empty() && ccl_function_task_map.empty()) {
       return "";
     }
 
+    ittFunctionInfoMap function_info_map = ccl_function_info_map;
+    for (auto& value : ccl_function_task_map) {
+      std::string name = std::string("oneCCL::") + IttGetFunctionName(value.first, value.second.ts);
+      auto it = function_info_map.find(name);
+      if (it == function_info_map.end()) {
+        function_info_map[name] = value.second.function;
+        continue;
+      }
+      // functions of the same name, or tasks of the function begun with a name
+      const ittFunction& function = value.second.function;
+      it->second.total_time += function.total_time;
+      it->second.min_time = std::min(it->second.min_time, function.min_time);
+      it->second.max_time = std::max(it->second.max_time, function.max_time);
+      it->second.call_count += function.call_count;
+    }
+
     std::set< std::pair<std::string, ittFunction>,
               utils::Comparator > sorted_list(
-        ccl_function_info_map.begin(), ccl_function_info_map.end());
+        function_info_map.begin(), function_info_map.end());
 
     uint64_t total_duration = 0;
     size_t max_name_length = kFunctionLength;
@@ -209,8 +300,11 @@ class IttCollector {
   OnIttLoggingCallback callback_ = nullptr;
   OnMpiLoggingCallback mpi_callback_ = nullptr;
   OnMpiInternalLoggingCallback mpi_internal_callback_ = nullptr;
+  OnIttMetadataLoggingCallback metadata_callback_ = nullptr;
+  OnIttThreadNameLoggingCallback thread_name_callback_ = nullptr;
   bool is_itt_ccl_summary_ = false;
   bool is_itt_chrome_logging_on_ = false;
+  bool is_itt_mpi_logging_on_ = false;
 };
 
 static IttCollector *itt_collector = nullptr;
@@ -220,15 +314,90 @@ static IttCollector *itt_collector = nullptr;
 #include "ittnotify.h"
 #include "ittnotify_config.h"
 
+#include "itt_counter.h"
+#include "itt_track.h"
+#include "itt_frame.h"
+#include "itt_region.h"
+#include "itt_overlapped.h"
+#include "itt_clock.h"
+#include "itt_histogram.h"
+#include "itt_sync.h"
+#include "itt_heap.h"
+#include "itt_relation.h"
+#include "itt_mpi.h"
+#include "itt_mark.h"
+#include "itt_model.h"
+#include "itt_module.h"
+#include "itt_symbol.h"
+
+static const char *IttGetFunctionName(const void *fn, uint64_t ts) {
+  return IttSymbols::GetName(fn, ts);
+}
+
 struct ThreadTaskDescriptor {
   char domain[512];
   char name[512];
   uint64_t start_time;
   IttArgs metadata_args;
+  uint64_t heap_allocations = 0;	// heap allocations made while the task is on the top of the stack
+  uint64_t heap_bytes = 0;
+  uint64_t relation_key = 0;	// key of the task in IttTaskRegistry if the task may be related to other tasks
+  IttVirtualTrack *track = nullptr;	// track of the thread when the task began, nullptr if the thread itself
+  void *fn = nullptr;	// function the task is named after if it began with __itt_task_begin_fn()
 };
 
 thread_local std::stack<ThreadTaskDescriptor> task_desc;
 
+// Task that created a caller of __itt_stack_caller_create(), e.g. the task that spawned a continuation
+struct IttStackCaller {
+  uint64_t task_key;	// key of the task in IttTaskRegistry
+};
+
+// Callers entered with __itt_stack_callee_enter() on the thread. Tasks begun at the depth of the task
+// stack of the thread when the caller was entered are children of the task of the caller.
+struct IttStackCallee {
+  uint64_t caller_task_key;
+  size_t depth;
+};
+
+thread_local std::vector<IttStackCallee> stack_callees;
+
+// Slices go to the given virtual track, or to the thread if there is none
+static void IttLogSlice(IttVirtualTrack *track, const char *name, uint64_t start_ts, uint64_t end_ts, IttArgs* metadata_args)
+{
+  if (track != nullptr) {
+    IttVirtualTracks::LogSlice(track, name, start_ts, end_ts, metadata_args);
+  }
+  else {
+    itt_collector->Log(name, start_ts, end_ts, metadata_args);
+  }
+}
+
+// Add an argument to the event of the task
+static void AddTaskMetadata(ThreadTaskDescriptor &task, const char *key, int type, size_t count, const void *data, size_t metadataSize)
+{
+  IttArgs* newArgs = &task.metadata_args, *next = newArgs->next;
+  void* dataDest = task.metadata_args.data;
+  if (newArgs->count) {
+    newArgs->next = (IttArgs*)malloc(std::max(metadataSize, sizeof(void*)) + sizeof(IttArgs) - sizeof(void*));
+    UniMemory::ExitIfOutOfMemory(newArgs->next);
+    newArgs = newArgs->next;
+    newArgs->isIndirectData = false;	// malloc() does not run the initializers of IttArgs
+    dataDest = newArgs->data;
+  }
+  else if (metadataSize > sizeof(void*)) {
+    dataDest = malloc(metadataSize);
+    UniMemory::ExitIfOutOfMemory(dataDest);
+    newArgs->isIndirectData = true;
+    newArgs->data[0] = dataDest;
+  }
+  memcpy(dataDest, data, metadataSize);
+  newArgs->key = key;
+  newArgs->count = count;
+  newArgs->type = type;
+  newArgs->next = next;
+}
+
 thread_local std::map<__itt_event, uint64_t> event_desc;
 
 static std::vector<std::string> itt_events;
@@ -301,8 +470,13 @@ ITT_EXTERN_C void ITTAPI __itt_pause(void)
   UniController::IttPause();
 }
 
+// ITT events are all host events. The offload scope has no effect: offload events follow __itt_pause()
+// and PTI_ENABLE_COLLECTION only.
 ITT_EXTERN_C void ITTAPI __itt_pause_scoped(__itt_collection_scope scope)
 {
+  if (scope & __itt_collection_scope_host) {
+    UniController::IttPauseScoped();
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_resume(void)
@@ -312,14 +486,42 @@ ITT_EXTERN_C void ITTAPI __itt_resume(void)
 
 ITT_EXTERN_C void ITTAPI __itt_resume_scoped(__itt_collection_scope scope)
 {
+  if (scope & __itt_collection_scope_host) {
+    UniController::IttResumeScoped();
+  }
 }
 
-ITT_EXTERN_C void ITTAPI __itt_task_begin(const __itt_domain *domain, __itt_id taskid, __itt_id parentid, __itt_string_handle *name) {
-  if (!UniController::IsCollectionEnabled()) {
+static inline bool IttIsNullId(const __itt_id& id) {
+  return ((id.d1 == __itt_null.d1) && (id.d2 == __itt_null.d2) && (id.d3 == __itt_null.d3));
+}
+
+// Adds the task to IttTaskRegistry on the track it is logged on, so flow arrows connect the slices
+static void IttRegisterTask(const ThreadTaskDescriptor &desc) {
+  uint32_t tid = (desc.track != nullptr) ? IttVirtualTracks::GetTid(desc.track) : utils::GetTid();
+  IttTaskRegistry::Begin(desc.relation_key, tid, desc.start_time);
+}
+
+// Key of the current task in IttTaskRegistry. A task without an id gets one the first time it is related.
+static uint64_t IttCurrentTaskKey(void) {
+  if (task_desc.empty()) {
+    return 0;
+  }
+  ThreadTaskDescriptor &desc = task_desc.top();
+  if (desc.relation_key == 0) {
+    desc.relation_key = IttTaskRegistry::GetUniqueKey();
+    IttRegisterTask(desc);
+  }
+  return desc.relation_key;
+}
+
+// The task begins at the given timestamp of the clock domain, or now if the timestamp is __itt_timestamp_none.
+// A task is named after either name or fn.
+static void IttTaskBegin(const __itt_domain *domain, __itt_id taskid, __itt_id parentid, __itt_string_handle *name, void *fn, const __itt_clock_domain *clock_domain, unsigned long long timestamp) {
+  if (!UniController::IsHostCollectionEnabled()) {
     return;
   }
 
-  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn() && !itt_collector->IsMpiLoggingOn()) {
     return;
   }
 
@@ -352,85 +554,168 @@ ITT_EXTERN_C void ITTAPI __itt_task_begin(const __itt_domain *domain, __itt_id t
   }
 #endif /* _WIN32 */
 
-  desc.start_time = UniTimer::GetHostTimestamp();
+  desc.start_time = IttClockDomains::ToHostTimestamp(clock_domain, timestamp);
+  desc.track = IttVirtualTracks::GetThreadTrack();
+  desc.fn = fn;
+  if (itt_collector->IsEnableChromeLoggingOn() && !IttIsNullId(taskid)) {
+    desc.relation_key = IttTaskRegistry::GetKey(domain, taskid);
+    IttRegisterTask(desc);
+  }
   task_desc.push(desc);
+
+  if (itt_collector->IsEnableChromeLoggingOn()) {
+    if (!IttIsNullId(parentid)) {
+      IttTaskRegistry::LogRelation(IttCurrentTaskKey(), __itt_relation_is_child_of, IttTaskRegistry::GetKey(domain, parentid));
+    }
+    else if (!stack_callees.empty() && (stack_callees.back().depth + 1 == task_desc.size())) {
+      // the task inherits the task of the caller as its logical parent
+      IttTaskRegistry::LogRelation(IttCurrentTaskKey(), __itt_relation_is_child_of, stack_callees.back().caller_task_key);
+    }
+  }
 }
 
-ITT_EXTERN_C void ITTAPI __itt_task_end(const __itt_domain *domain)
+ITT_EXTERN_C void ITTAPI __itt_task_begin(const __itt_domain *domain, __itt_id taskid, __itt_id parentid, __itt_string_handle *name) {
+  IttTaskBegin(domain, taskid, parentid, name, nullptr, nullptr, __itt_timestamp_none);
+}
+
+static void IttTaskEnd(const __itt_domain *domain, const __itt_clock_domain *clock_domain, unsigned long long timestamp)
 {
-  if (!UniController::IsCollectionEnabled()) {
+  if (!UniController::IsHostCollectionEnabled()) {
     return;
   }
 
-  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn() && !itt_collector->IsMpiLoggingOn()) {
     return;
   }
 
   if (!task_desc.empty() && domain != nullptr && !strcmp(task_desc.top().domain, domain->nameA)) {
     char task[1057];
 
-    snprintf(task, 1056, "%s::%s", task_desc.top().domain, task_desc.top().name);
+    ThreadTaskDescriptor &desc = task_desc.top();
+    snprintf(task, 1056, "%s::%s", desc.domain, desc.name);
 
-    std::string name = task_desc.top().domain;
-    name+="::";
-    name+=task_desc.top().name;
-    auto start = task_desc.top().start_time;
-    auto end = UniTimer::GetHostTimestamp();
+    std::string name = task;
+    auto start = desc.start_time;
+    auto end = IttClockDomains::ToHostTimestamp(clock_domain, timestamp);
 
+    // tasks of functions are summarized by function and named when the summaries are printed
     if (itt_collector->IsCclSummaryOn()) {
-      AddFunctionTime(name, end-start);
+      if (desc.fn != nullptr) {
+        AddFunctionTime(desc.domain, desc.fn, start, end-start);
+      }
+      else {
+        AddFunctionTime(name, end-start);
+      }
+    }
+    if (desc.heap_allocations > 0) {
+      if (desc.fn != nullptr) {
+        IttHeapFunctions::AddTaskAllocations(domain->nameA, desc.fn, start, desc.heap_allocations, desc.heap_bytes);
+      }
+      else {
+        IttHeapFunctions::AddTaskAllocations(name, desc.heap_allocations, desc.heap_bytes);
+      }
+      if (itt_collector->IsEnableChromeLoggingOn()) {
+        AddTaskMetadata(desc, "heap_allocations", __itt_metadata_u64, 1, &desc.heap_allocations, sizeof(desc.heap_allocations));
+        AddTaskMetadata(desc, "heap_bytes", __itt_metadata_u64, 1, &desc.heap_bytes, sizeof(desc.heap_bytes));
+      }
+    }
+    if (desc.relation_key != 0) {
+      IttTaskRegistry::End(desc.relation_key, end);
     }
     if (itt_collector->IsEnableChromeLoggingOn()) {
-      itt_collector->Log(task, start, end, &task_desc.top().metadata_args);
+      if (desc.fn != nullptr) {
+        IttSymbols::LogSlice(desc.track, domain->nameA, desc.fn, start, end, &desc.metadata_args);
+      }
+      else {
+        IttLogSlice(desc.track, task, start, end, &desc.metadata_args);
+      }
     }
     task_desc.pop();
   }
 }
 
+ITT_EXTERN_C void ITTAPI __itt_task_end(const __itt_domain *domain)
+{
+  IttTaskEnd(domain, nullptr, __itt_timestamp_none);
+}
+
+// End of an MPI task with the message it sent and/or received
 ITT_EXTERN_C void ITTAPI __itt_task_end_internal_ex_info(const __itt_domain *domain,
                                      size_t src_size, int src_location, int src_tag,
                                      size_t dst_size, int dst_location, int dst_tag)
 {
-  if (!UniController::IsCollectionEnabled() || !itt_collector->IsEnableChromeLoggingOn()) {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn() && !itt_collector->IsMpiLoggingOn()) {
     return;
   }
 
-  if (task_desc.empty() || strcmp(task_desc.top().domain, domain->nameA)) {
+  if (task_desc.empty() || domain == nullptr || strcmp(task_desc.top().domain, domain->nameA)) {
     return;
   }
 
-  std::string display(task_desc.top().domain);
+  ThreadTaskDescriptor &desc = task_desc.top();
+  std::string display(desc.domain);
   display += "::";
-  display += task_desc.top().name;
-  auto start = task_desc.top().start_time;
+  display += (desc.fn != nullptr) ? IttSymbols::GetName(desc.fn, desc.start_time) : desc.name;
+  auto start = desc.start_time;
   auto end = UniTimer::GetHostTimestamp();
 
-  if (itt_collector->IsEnableChromeLoggingOn()) {
-    itt_collector->Log(display.c_str(), start, end, src_size, src_location, src_tag,
-                                     dst_size, dst_location, dst_tag);
+  if (itt_collector->IsCclSummaryOn()) {
+    AddFunctionTime(display, end-start);
+  }
+  if (desc.relation_key != 0) {
+    IttTaskRegistry::End(desc.relation_key, end);
+  }
+  if (itt_collector->IsMpiLoggingOn()) {
+    IttMpiMessages::Add(src_size, src_location, dst_size, dst_location);
+    itt_collector->Log((desc.track != nullptr) ? IttVirtualTracks::GetTid(desc.track) : 0, display.c_str(), start, end,
+                       src_size, src_location, src_tag, dst_size, dst_location, dst_tag, &desc.metadata_args);
+  }
+  else if (itt_collector->IsEnableChromeLoggingOn()) {
+    IttLogSlice(desc.track, display.c_str(), start, end, &desc.metadata_args);
   }
   task_desc.pop();
 }
 
+// End of an MPI task with the number of iterations of the progress engine it took
 ITT_EXTERN_C void ITTAPI __itt_task_end_internal_callback_info(const __itt_domain *domain,
                                      int64_t mpi_counter,  size_t src_size, size_t dst_size)
 {
-  if (!UniController::IsCollectionEnabled() || !itt_collector->IsEnableChromeLoggingOn()) {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn() && !itt_collector->IsMpiLoggingOn()) {
     return;
   }
 
-  if (task_desc.empty() || strcmp(task_desc.top().domain, domain->nameA)) {
+  if (task_desc.empty() || domain == nullptr || strcmp(task_desc.top().domain, domain->nameA)) {
     return;
   }
 
-  std::string display(task_desc.top().domain);
+  ThreadTaskDescriptor &desc = task_desc.top();
+  std::string display(desc.domain);
   display += "::";
-  display += task_desc.top().name;
-  auto start = task_desc.top().start_time;
+  display += (desc.fn != nullptr) ? IttSymbols::GetName(desc.fn, desc.start_time) : desc.name;
+  auto start = desc.start_time;
   auto end = UniTimer::GetHostTimestamp();
 
-  if (itt_collector->IsEnableChromeLoggingOn()) {
-    itt_collector->Log(display.c_str(), start, end, mpi_counter, src_size, dst_size);
+  if (itt_collector->IsCclSummaryOn()) {
+    AddFunctionTime(display, end-start);
+  }
+  if (desc.relation_key != 0) {
+    IttTaskRegistry::End(desc.relation_key, end);
+  }
+  if (itt_collector->IsMpiLoggingOn()) {
+    IttMpiMessages::AddProgress(display, mpi_counter, src_size, dst_size);
+    itt_collector->Log((desc.track != nullptr) ? IttVirtualTracks::GetTid(desc.track) : 0, display.c_str(), start, end,
+                       mpi_counter, src_size, dst_size, &desc.metadata_args);
+  }
+  else if (itt_collector->IsEnableChromeLoggingOn()) {
+    IttLogSlice(desc.track, display.c_str(), start, end, &desc.metadata_args);
   }
   task_desc.pop();
 }
@@ -451,7 +736,7 @@ ITT_EXTERN_C __itt_event ITTAPI __itt_event_create(const char *name, int namelen
 }
 
 ITT_EXTERN_C int ITTAPI __itt_event_start(__itt_event event) {
-  if (!UniController::IsCollectionEnabled()) {
+  if (!UniController::IsHostCollectionEnabled()) {
     return __itt_error_success;
   }
   
@@ -470,7 +755,7 @@ ITT_EXTERN_C int ITTAPI __itt_event_start(__itt_event event) {
 }
 
 ITT_EXTERN_C int ITTAPI __itt_event_end(__itt_event event) {
-  if (!UniController::IsCollectionEnabled()) {
+  if (!UniController::IsHostCollectionEnabled()) {
     return __itt_error_success;
   }
 
@@ -493,7 +778,7 @@ ITT_EXTERN_C int ITTAPI __itt_event_end(__itt_event event) {
       AddFunctionTime(itt_events[event], end-start);
     }
     if (itt_collector->IsEnableChromeLoggingOn()) {
-      itt_collector->Log(itt_events[event].c_str(), start, end, nullptr);
+      IttLogSlice(IttVirtualTracks::GetThreadTrack(), itt_events[event].c_str(), start, end, nullptr);
     }
     //__itt_mutex_unlock(&(itt_global->mutex));
     return __itt_error_success;
@@ -503,9 +788,9 @@ ITT_EXTERN_C int ITTAPI __itt_event_end(__itt_event event) {
 }
 
 
-ITT_EXTERN_C void ITTAPI __itt_marker(const __itt_domain *domain, __itt_id id, __itt_string_handle *name, __itt_scope scope)
+static void IttMarker(const __itt_domain *domain, __itt_id id, __itt_string_handle *name, const __itt_clock_domain *clock_domain, unsigned long long timestamp)
 {
-  if (!UniController::IsCollectionEnabled()) {
+  if (!UniController::IsHostCollectionEnabled()) {
     return;
   }
 
@@ -552,8 +837,13 @@ ITT_EXTERN_C void ITTAPI __itt_marker(const __itt_domain *domain, __itt_id id, _
     }
   }
     
-  uint64_t ts = UniTimer::GetHostTimestamp();
-  itt_collector->Log(marker, ts, ts, nullptr);
+  uint64_t ts = IttClockDomains::ToHostTimestamp(clock_domain, timestamp);
+  IttLogSlice(IttVirtualTracks::GetThreadTrack(), marker, ts, ts, nullptr);
+}
+
+ITT_EXTERN_C void ITTAPI __itt_marker(const __itt_domain *domain, __itt_id id, __itt_string_handle *name, __itt_scope scope)
+{
+  IttMarker(domain, id, name, nullptr, __itt_timestamp_none);
 }
 
 // Need these empty stubs to make sure symbols are resolved in case any of these symbols are present in target application
@@ -566,12 +856,25 @@ ITT_EXTERN_C __itt_pt_region ITTAPI __itt_pt_region_create(const char *name)
   return 0;
 }
 
+// threads are named even if collection is paused
 ITT_EXTERN_C void ITTAPI __itt_thread_set_name(const char *name)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if (!itt_collector->IsEnableChromeLoggingOn() || (name == nullptr) || (name[0] == 0)) {
+    return;
+  }
+
+  itt_collector->LogThreadName(name);
 }
 
+// Every ITT call of an ignored thread that records an event returns on its first check. Calls that create
+// domains, string handles, counters and other objects still work, because the objects may be used by other threads.
 ITT_EXTERN_C void ITTAPI __itt_thread_ignore(void)
 {
+  UniController::IttIgnoreThread();
 }
 
 ITT_EXTERN_C void ITTAPI __itt_suppress_push(unsigned int mask)
@@ -592,110 +895,251 @@ ITT_EXTERN_C void ITTAPI __itt_suppress_clear_range(__itt_suppress_mode_t mode,
 
 ITT_EXTERN_C void ITTAPI __itt_sync_create (void *addr, const char *objtype, const char *objname, int attribute)
 {
+  // objects are named even if collection is paused
+  IttSyncObjects::Create(addr, objtype, objname);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_sync_rename(void *addr, const char *name)
 {
+  IttSyncObjects::Rename(addr, name);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_sync_destroy(void *addr)
 {
+  IttSyncObjects::Destroy(addr);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_sync_prepare(void* addr)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttSyncObjects::Prepare(addr, UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_sync_cancel(void *addr)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttSyncObjects::Cancel(addr);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_sync_acquired(void *addr)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  uint64_t end = UniTimer::GetHostTimestamp();
+  uint64_t start;
+  IttSyncStats *stats;
+  uint64_t wait = IttSyncObjects::Acquired(addr, end, start, stats);
+  uint64_t threshold = IttSyncObjects::GetWaitThreshold();
+  if ((threshold > 0) && (wait >= threshold) && itt_collector->IsEnableChromeLoggingOn()) {
+    std::string name = stats->name_ + " (wait)";
+    IttLogSlice(IttVirtualTracks::GetThreadTrack(), name.c_str(), start, end, nullptr);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_sync_releasing(void* addr)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttSyncObjects::Releasing(addr, UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_fsync_prepare(void* addr)
 {
+  __itt_sync_prepare(addr);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_fsync_cancel(void *addr)
 {
+  __itt_sync_cancel(addr);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_fsync_acquired(void *addr)
 {
+  __itt_sync_acquired(addr);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_fsync_releasing(void* addr)
 {
+  __itt_sync_releasing(addr);
+}
+
+// Sites are tracked even if collection is paused, so a site that begins paused and ends resumed, or the
+// other way round, still ends the instance it began
+static void IttModelSiteBegin(const char *name, size_t length)
+{
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttModelSites::SiteBegin(name, length, UniTimer::GetHostTimestamp(), UniController::IsHostCollectionEnabled());
+}
+
+static void IttModelSiteEnd(void)
+{
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttModelSites::SiteEnd(UniTimer::GetHostTimestamp(), UniController::IsHostCollectionEnabled());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_site_begin(__itt_model_site *site, __itt_model_site_instance *instance, const char *name)
 {
+  IttModelSiteBegin(name, std::string::npos);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_site_beginA(const char *name)
 {
+  IttModelSiteBegin(name, std::string::npos);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_site_beginAL(const char *name, size_t siteNameLen)
 {
+  IttModelSiteBegin(name, siteNameLen);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_site_end  (__itt_model_site *site, __itt_model_site_instance *instance)
 {
+  IttModelSiteEnd();
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_site_end_2(void)
 {
+  IttModelSiteEnd();
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_task_begin(__itt_model_task *task, __itt_model_task_instance *instance, const char *name)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::TaskBegin(UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_task_beginA(const char *name)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::TaskBegin(UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_task_beginAL(const char *name, size_t taskNameLen)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  // tasks are accounted to their sites, whatever their names
+  IttModelSites::TaskBegin(UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_iteration_taskA(const char *name)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::IterationTask(UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_iteration_taskAL(const char *name, size_t taskNameLen)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::IterationTask(UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_task_end  (__itt_model_task *task, __itt_model_task_instance *instance)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::TaskEnd(UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_task_end_2(void)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::TaskEnd(UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_lock_acquire(void *lock)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::LockAcquire(lock, UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_lock_acquire_2(void *lock)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::LockAcquire(lock, UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_lock_release(void *lock)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::LockRelease(lock, UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_lock_release_2(void *lock)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttModelSites::LockRelease(lock, UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_model_record_allocation  (void *addr, size_t size)
@@ -736,31 +1180,99 @@ ITT_EXTERN_C void ITTAPI __itt_model_aggregate_task(size_t x)
 
 ITT_EXTERN_C __itt_heap_function ITTAPI __itt_heap_function_create(const char* name, const char* domain)
 {
-  return 0;
+  return (__itt_heap_function)IttHeapFunctions::Create(name, domain);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_heap_allocate_begin(__itt_heap_function h, size_t size, int initialized)
 {
 }
 
+// Allocations are attributed to the task on the top of the stack of the thread
+static void AddTaskHeapAllocation(size_t size)
+{
+  if (!task_desc.empty()) {
+    task_desc.top().heap_allocations++;
+    task_desc.top().heap_bytes += size;
+  }
+}
+
 ITT_EXTERN_C void ITTAPI __itt_heap_allocate_end(__itt_heap_function h, void** addr, size_t size, int initialized)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  if (h == nullptr) {
+    return;
+  }
+
+  IttHeapFunctions::Allocated((IttHeapFunction *)h, (addr != nullptr) ? *addr : nullptr, size);
+  AddTaskHeapAllocation(size);
+}
+
+// Samples of freed blocks are dropped even if collection is paused, so live bytes stay right. They are
+// dropped before the block is freed, as the address may be allocated again by another thread before
+// the free ends.
+static void DropHeapSample(__itt_heap_function h, void* addr)
+{
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  if (h == nullptr) {
+    return;
+  }
+
+  IttHeapFunctions::Freed(addr);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_heap_free_begin(__itt_heap_function h, void* addr)
 {
+  DropHeapSample(h, addr);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_heap_free_end(__itt_heap_function h, void* addr)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  if (h == nullptr) {
+    return;
+  }
+
+  IttHeapFunctions::Free((IttHeapFunction *)h);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_heap_reallocate_begin(__itt_heap_function h, void* addr, size_t new_size, int initialized)
 {
+  DropHeapSample(h, addr);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_heap_reallocate_end(__itt_heap_function h, void* addr, void** new_addr, size_t new_size, int initialized)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  if (h == nullptr) {
+    return;
+  }
+
+  IttHeapFunctions::Reallocated((IttHeapFunction *)h, (new_addr != nullptr) ? *new_addr : nullptr, new_size);
+  AddTaskHeapAllocation(new_size);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_heap_internal_access_begin(void)
@@ -797,27 +1309,89 @@ ITT_EXTERN_C void ITTAPI __itt_id_destroy(const __itt_domain *domain, __itt_id i
 
 ITT_EXTERN_C __itt_timestamp ITTAPI __itt_get_timestamp(void)
 {
-  return 0;
+  return UniTimer::GetHostTimestamp();
 }
 
 ITT_EXTERN_C void ITTAPI __itt_region_begin(const __itt_domain *domain, __itt_id id, __itt_id parentid, __itt_string_handle *name)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttRegions::Begin(domain, id, name, UniTimer::GetHostTimestamp());
 }
 
+// A region begun while collecting ends even if collection has been paused since, so its async
+// events stay paired, but only regions that end while collecting are summarized
 ITT_EXTERN_C void ITTAPI __itt_region_end(const __itt_domain *domain, __itt_id id)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttRegionDescriptor desc;
+  auto end = UniTimer::GetHostTimestamp();
+  if (!IttRegions::End(domain, id, end, desc)) {
+    return;	// region end without region begin
+  }
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  IttRegionTimes::Add(desc.name_, end - desc.start_time_);
+  if (itt_collector->IsCclSummaryOn()) {
+    AddFunctionTime(desc.name_, end - desc.start_time_);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_frame_begin_v3(const __itt_domain *domain, __itt_id *id)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttFrames::Begin(domain, id, UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_frame_end_v3(const __itt_domain *domain, __itt_id *id)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttFrames::End(domain, id, UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_frame_submit_v3(const __itt_domain *domain, __itt_id *id, __itt_timestamp begin, __itt_timestamp end)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  if (end == __itt_timestamp_none) {
+    end = UniTimer::GetHostTimestamp();
+  }
+  IttFrames::Submit(domain, begin, end);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_task_group(const __itt_domain *domain, __itt_id id, __itt_id parentid, __itt_string_handle *name)
@@ -826,204 +1400,355 @@ ITT_EXTERN_C void ITTAPI __itt_task_group(const __itt_domain *domain, __itt_id i
 
 ITT_EXTERN_C void ITTAPI __itt_task_begin_fn(const __itt_domain *domain, __itt_id taskid, __itt_id parentid, void* fn)
 {
+  IttTaskBegin(domain, taskid, parentid, nullptr, fn, nullptr, __itt_timestamp_none);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_task_begin_overlapped(const __itt_domain* domain, __itt_id taskid, __itt_id parentid, __itt_string_handle* name)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttOverlappedTasks::Begin(domain, taskid, name, UniTimer::GetHostTimestamp());
+}
+
+// A task begun while collecting ends even if collection has been paused since or the task ends on an
+// ignored thread, so its async events stay paired, but only tasks that end while collecting are summarized
+static void IttOverlappedTaskEnd(const __itt_domain *domain, __itt_id taskid, uint64_t end)
+{
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttOverlappedTask task;
+  if (!IttOverlappedTasks::End(domain, taskid, end, task) || !UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+  uint64_t time = (end > task.start_time_) ? (end - task.start_time_) : 0;
+  IttOverlappedTaskTimes::Add(task.name_, time);
+  if (itt_collector->IsCclSummaryOn()) {
+    AddFunctionTime(task.name_, time);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_task_end_overlapped(const __itt_domain *domain, __itt_id taskid)
 {
+  IttOverlappedTaskEnd(domain, taskid, UniTimer::GetHostTimestamp());
 }
 
 ITT_EXTERN_C void ITTAPI __itt_metadata_add(const __itt_domain *domain, __itt_id id, __itt_string_handle *key, __itt_metadata_type type, size_t count, void *data)
 {
-  if (!UniController::IsCollectionEnabled()) {
+  if (!UniController::IsHostCollectionEnabled()) {
     return;
   }
   if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
     return;
   }
-  if (count && data && !task_desc.empty() && type > __itt_metadata_unknown && type < __itt_metadata_double) {
-    ThreadTaskDescriptor &task = task_desc.top();
-    IttArgs* newArgs = &task.metadata_args, *next = newArgs->next;
-    void* dataDest = task.metadata_args.data;
-    size_t metadataSize = count * metadata_type_sizes[type];
-    if (newArgs->count) {
-      newArgs->next = (IttArgs*)malloc(std::max(metadataSize, sizeof(void*)) + sizeof(IttArgs) - sizeof(void*));
-      UniMemory::ExitIfOutOfMemory(newArgs->next);
-      newArgs = newArgs->next;
-      dataDest = newArgs->data;
-    }
-    else if (metadataSize > sizeof(void*)) {
-      dataDest = malloc(metadataSize);
-      UniMemory::ExitIfOutOfMemory(dataDest);
-      newArgs->isIndirectData = true;
-      newArgs->data[0] = dataDest;
-    }
-    memcpy(dataDest, data, metadataSize);
-    newArgs->key = key->strA;
-    newArgs->count = count;
-    newArgs->type = type;
-    newArgs->next = next;
+  if (count && data && !task_desc.empty() && type > __itt_metadata_unknown && type <= __itt_metadata_double) {
+    AddTaskMetadata(task_desc.top(), key->strA, type, count, data, count * metadata_type_sizes[type]);
   }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_metadata_str_add(const __itt_domain *domain, __itt_id id, __itt_string_handle *key, const char *data, size_t length) {
-  if (!UniController::IsCollectionEnabled()) {
+  if (!UniController::IsHostCollectionEnabled()) {
     return;
   }
   if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
     return;
   }
   if (length && data && !task_desc.empty()) {
-    ThreadTaskDescriptor &task = task_desc.top();
-    IttArgs* newArgs = &task.metadata_args, *next = newArgs->next;
-    void* dataDest = task.metadata_args.data;
-    size_t metadataSize = length * metadata_type_sizes[0];
-    if (newArgs->count) {
-      newArgs->next = (IttArgs*)malloc(std::max(metadataSize, sizeof(void*)) + sizeof(IttArgs) - sizeof(void*));
-      UniMemory::ExitIfOutOfMemory(newArgs->next);
-      newArgs = newArgs->next;
-      dataDest = newArgs->data;
+    // itt_metadata_unknown is considered a string for us
+    AddTaskMetadata(task_desc.top(), key->strA, 0, length, data, length * metadata_type_sizes[0]);
+  }
+}
+
+// Metadata of the global scope is logged once for the process, and metadata of the track and track
+// group scopes once for the thread, or for its virtual track if it has one. Metadata of the task scope
+// is an argument of the current task. Other scopes are ignored.
+static void IttAddScopedMetadata(__itt_scope scope, __itt_string_handle *key, int type, size_t count, const void *data, size_t metadataSize)
+{
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+  if ((key == nullptr) || (key->strA == nullptr)) {
+    return;
+  }
+
+  if (scope == __itt_scope_task) {
+    if (!task_desc.empty()) {
+      AddTaskMetadata(task_desc.top(), key->strA, type, count, data, metadataSize);
     }
-    else if (metadataSize > sizeof(void*)) {
-      dataDest = malloc(metadataSize);
-      UniMemory::ExitIfOutOfMemory(dataDest);
-      newArgs->isIndirectData = true;
-      newArgs->data[0] = dataDest;
+    return;
+  }
+  if (!itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  uint32_t tid = 0;
+  if ((scope == __itt_scope_track) || (scope == __itt_scope_track_group)) {
+    IttVirtualTrack *track = IttVirtualTracks::GetThreadTrack();
+    if (track != nullptr) {
+      tid = IttVirtualTracks::GetTid(track);
     }
-    memcpy(dataDest, data, metadataSize);
-    newArgs->key = key->strA;
-    newArgs->count = length;
-    newArgs->type = 0;  // itt_metadata_unknown is considered a string for us
-    newArgs->next = next;
   }
+  else if (scope != __itt_scope_global) {
+    return;
+  }
+
+  IttArgs args;
+  args.key = key->strA;
+  args.type = type;
+  args.count = count;
+  args.next = nullptr;
+  if (metadataSize > sizeof(void*)) {
+    args.data[0] = malloc(metadataSize);
+    UniMemory::ExitIfOutOfMemory(args.data[0]);
+    args.isIndirectData = true;
+    memcpy(args.data[0], data, metadataSize);
+  }
+  else {
+    args.isIndirectData = false;
+    memcpy(args.data, data, metadataSize);
+  }
+  itt_collector->LogMetadata(tid, scope == __itt_scope_global, &args);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_metadata_add_with_scope(const __itt_domain *domain, __itt_scope scope, __itt_string_handle *key, __itt_metadata_type type, size_t count, void *data)
 {
+  if (count && data && type > __itt_metadata_unknown && type <= __itt_metadata_double) {
+    IttAddScopedMetadata(scope, key, type, count, data, count * metadata_type_sizes[type]);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_metadata_str_add_with_scope(const __itt_domain *domain, __itt_scope scope, __itt_string_handle *key, const char *data, size_t length)
 {
+  if (data && (length == 0)) {
+    length = strlen(data);
+  }
+  if (length && data) {
+    // itt_metadata_unknown is considered a string for us
+    IttAddScopedMetadata(scope, key, 0, length, data, length * metadata_type_sizes[0]);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_relation_add_to_current(const __itt_domain *domain, __itt_relation relation, __itt_id tail)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttTaskRegistry::LogRelation(IttCurrentTaskKey(), relation, IttTaskRegistry::GetKey(domain, tail));
 }
 
 ITT_EXTERN_C void ITTAPI __itt_relation_add(const __itt_domain *domain, __itt_id head, __itt_relation relation, __itt_id tail)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttTaskRegistry::LogRelation(IttTaskRegistry::GetKey(domain, head), relation, IttTaskRegistry::GetKey(domain, tail));
 }
 
 ITT_EXTERN_C __itt_clock_domain* ITTAPI __itt_clock_domain_create(__itt_get_clock_info_fn fn, void* fn_data)
 {
-  return 0;
+  return IttClockDomains::Create(fn, fn_data);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_clock_domain_reset(void)
 {
+  IttClockDomains::Reset();
 }
 
 ITT_EXTERN_C void ITTAPI __itt_id_create_ex(const __itt_domain* domain, __itt_clock_domain* clock_domain, unsigned long long timestamp, __itt_id id)
 {
+  // ids are not tracked, so the timestamp is not needed
+  __itt_id_create(domain, id);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_id_destroy_ex(const __itt_domain* domain, __itt_clock_domain* clock_domain, unsigned long long timestamp, __itt_id id)
 {
+  __itt_id_destroy(domain, id);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_task_begin_ex(const __itt_domain* domain, __itt_clock_domain* clock_domain, unsigned long long timestamp, __itt_id taskid,      __itt_id parentid, __itt_string_handle* name)
 {
+  IttTaskBegin(domain, taskid, parentid, name, nullptr, clock_domain, timestamp);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_task_begin_fn_ex(const __itt_domain* domain, __itt_clock_domain* clock_domain, unsigned long long timestamp, __itt_id taskid, __itt_id parentid, void* fn)
 {
+  IttTaskBegin(domain, taskid, parentid, nullptr, fn, clock_domain, timestamp);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_task_end_ex(const __itt_domain* domain, __itt_clock_domain* clock_domain, unsigned long long timestamp)
 {
+  IttTaskEnd(domain, clock_domain, timestamp);
 }
 
 ITT_EXTERN_C __itt_counter ITTAPI __itt_counter_create(const char *name, const char *domain)
 {
-  return 0;
+  return (__itt_counter)IttCounterSampler::GetCounter(domain, name, __itt_metadata_u64);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_inc(__itt_counter id)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if (id != nullptr) {
+    ((IttCounter *)id)->Add(1);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_inc_delta(__itt_counter id, unsigned long long value)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if (id != nullptr) {
+    ((IttCounter *)id)->Add((int64_t)value);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_dec(__itt_counter id)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if (id != nullptr) {
+    ((IttCounter *)id)->Add(-1);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_dec_delta(__itt_counter id, unsigned long long value)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if (id != nullptr) {
+    ((IttCounter *)id)->Add(-(int64_t)value);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_inc_v3(const __itt_domain *domain, __itt_string_handle *name)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttCounterSampler::GetCounter(domain, name)->Add(1);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_inc_delta_v3(const __itt_domain *domain, __itt_string_handle *name, unsigned long long delta)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttCounterSampler::GetCounter(domain, name)->Add((int64_t)delta);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_dec_v3(const __itt_domain *domain, __itt_string_handle *name)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttCounterSampler::GetCounter(domain, name)->Add(-1);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_dec_delta_v3(const __itt_domain *domain, __itt_string_handle *name, unsigned long long delta)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  IttCounterSampler::GetCounter(domain, name)->Add(-(int64_t)delta);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_set_value(__itt_counter id, void *value_ptr)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if ((id != nullptr) && (value_ptr != nullptr)) {
+    ((IttCounter *)id)->Set(value_ptr);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_set_value_ex(__itt_counter id, __itt_clock_domain *clock_domain, unsigned long long timestamp, void *value_ptr)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  // the value is sampled, so the timestamp of the update is not used
+  if ((id != nullptr) && (value_ptr != nullptr)) {
+    ((IttCounter *)id)->Set(value_ptr);
+  }
 }
 
 ITT_EXTERN_C __itt_counter ITTAPI __itt_counter_create_typed(const char *name, const char *domain, __itt_metadata_type type)
 {
-  return 0;
+  return (__itt_counter)IttCounterSampler::GetCounter(domain, name, type);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_counter_destroy(__itt_counter id)
 {
+  if (id != nullptr) {
+    ((IttCounter *)id)->destroyed_.store(true, std::memory_order_release);
+  }
 }
 
 ITT_EXTERN_C void ITTAPI __itt_marker_ex(const __itt_domain *domain,  __itt_clock_domain* clock_domain, unsigned long long timestamp, __itt_id id, __itt_string_handle *name, __itt_scope scope)
 {
+  IttMarker(domain, id, name, clock_domain, timestamp);
 }
 
+// Relations are drawn between the tasks, so the timestamp is not needed
 ITT_EXTERN_C void ITTAPI __itt_relation_add_to_current_ex(const __itt_domain *domain,  __itt_clock_domain* clock_domain, unsigned long long timestamp, __itt_relation relation, __itt_id tail)
 {
+  __itt_relation_add_to_current(domain, relation, tail);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_relation_add_ex(const __itt_domain *domain,  __itt_clock_domain* clock_domain, unsigned long long timestamp, __itt_id head, __itt_relation relation, __itt_id tail)
 {
+  __itt_relation_add(domain, head, relation, tail);
 }
 
 ITT_EXTERN_C __itt_track_group* ITTAPI __itt_track_group_create(__itt_string_handle* name, __itt_track_group_type track_group_type)
 {
-  return 0;
+  return IttVirtualTracks::CreateGroup(name, track_group_type);
 }
 
 ITT_EXTERN_C __itt_track* ITTAPI __itt_track_create(__itt_track_group* track_group, __itt_string_handle* name, __itt_track_type track_type)
 {
-  return 0;
+  return IttVirtualTracks::CreateTrack(track_group, name, track_type);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_set_track(__itt_track* track)
 {
+  IttVirtualTracks::SetThreadTrack(track);
 }
 
 ITT_EXTERN_C int ITTAPI __itt_av_save(void *data, int rank, const int *dimensions, int type, const char *filePath, int columnOrder)
@@ -1035,79 +1760,160 @@ ITT_EXTERN_C void ITTAPI __itt_enable_attach(void)
 {
 }
 
+// modules are mapped and logged even if collection is paused, so tasks after resume resolve against them
 ITT_EXTERN_C void ITTAPI __itt_module_load(void *start_addr, void *end_addr, const char *path)
 {
+  IttModules::Load(start_addr, end_addr, path);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_module_unload(void *addr)
 {
+  IttModules::Unload(addr);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_module_load_with_sections(__itt_module_object* module_obj)
 {
+  IttModules::LoadSections(module_obj);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_module_unload_with_sections(__itt_module_object* module_obj)
 {
+  IttModules::UnloadSections(module_obj);
 }
 
 ITT_EXTERN_C __itt_histogram* ITTAPI __itt_histogram_create(const __itt_domain* domain, const char* name, __itt_metadata_type x_type, __itt_metadata_type y_type)
 {
-  return 0;
+  return IttHistograms::Create(domain, name, x_type, y_type);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_histogram_submit(__itt_histogram* hist, size_t length, void* x_data, void* y_data)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttHistograms::Submit(hist, length, x_data, y_data);
 }
 
 ITT_EXTERN_C void ITTAPI __itt_task_begin_overlapped_ex(const __itt_domain* domain, __itt_clock_domain* clock_domain, unsigned long long timestamp, __itt_id taskid, __itt_id parentid, __itt_string_handle* name)
 {
+  if (!UniController::IsHostCollectionEnabled()) {
+    return;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return;
+  }
+
+  IttOverlappedTasks::Begin(domain, taskid, name, IttClockDomains::ToHostTimestamp(clock_domain, timestamp));
 }
 
 ITT_EXTERN_C void ITTAPI __itt_task_end_overlapped_ex(const __itt_domain* domain, __itt_clock_domain* clock_domain, unsigned long long timestamp, __itt_id taskid)
 {
+  IttOverlappedTaskEnd(domain, taskid, IttClockDomains::ToHostTimestamp(clock_domain, timestamp));
 }
 
 ITT_EXTERN_C __itt_mark_type ITTAPI __itt_mark_create(const char *name)
 {
+  return IttMarks::Create(name);
+}
+
+// Marks are instant events of the process, or of all processes if global. Only marks that are not
+// off are counted.
+static int IttMark(__itt_mark_type mt, const char *parameter, bool global, bool off)
+{
+  if (!UniController::IsHostCollectionEnabled()) {
+    return 0;
+  }
+
+  if (!itt_collector->IsCclSummaryOn() && !itt_collector->IsEnableChromeLoggingOn()) {
+    return 0;
+  }
+
+  IttMarkType *type = IttMarks::Get(mt);
+  if (type == nullptr) {
+    return -1;
+  }
+
+  uint64_t ts = UniTimer::GetHostTimestamp();
+  if (!off) {
+    IttMarks::Mark(type, ts);
+  }
+  if (itt_collector->IsEnableChromeLoggingOn()) {
+    IttVirtualTrack *track = IttVirtualTracks::GetThreadTrack();
+    IttMarks::Log((track != nullptr) ? IttVirtualTracks::GetTid(track) : 0, off ? type->off_name_.c_str() : type->name_.c_str(), ts, global, parameter);
+  }
   return 0;
 }
 
 ITT_EXTERN_C int ITTAPI __itt_mark(__itt_mark_type mt, const char *parameter)
 {
-  return 0;
+  return IttMark(mt, parameter, false, false);
 }
 
 ITT_EXTERN_C int ITTAPI __itt_mark_global(__itt_mark_type mt, const char *parameter)
 {
-  return 0;
+  return IttMark(mt, parameter, true, false);
 }
 
 ITT_EXTERN_C int ITTAPI __itt_mark_off(__itt_mark_type mt)
 {
-  return 0;
+  return IttMark(mt, nullptr, false, true);
 }
 
 ITT_EXTERN_C int ITTAPI __itt_mark_global_off(__itt_mark_type mt)
 {
-  return 0;
+  return IttMark(mt, nullptr, true, true);
 }
 
 ITT_EXTERN_C __itt_caller ITTAPI __itt_stack_caller_create(void)
 {
-  return 0;
+  if (!UniController::IsHostCollectionEnabled()) {
+    return 0;
+  }
+
+  if (!itt_collector->IsEnableChromeLoggingOn() || task_desc.empty()) {
+    return 0;
+  }
+
+  IttStackCaller *caller = new IttStackCaller();
+  UniMemory::ExitIfOutOfMemory((void *)caller);
+  caller->task_key = IttCurrentTaskKey();
+  return (__itt_caller)caller;
 }
 
 ITT_EXTERN_C void ITTAPI __itt_stack_caller_destroy(__itt_caller id)
 {
+  delete (IttStackCaller *)id;
 }
 
+// The task of the caller is copied, so the caller may be destroyed while it is entered
 ITT_EXTERN_C void ITTAPI __itt_stack_callee_enter(__itt_caller id)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  if (id == 0) {
+    return;
+  }
+  stack_callees.push_back({((IttStackCaller *)id)->task_key, task_desc.size()});
 }
 
 ITT_EXTERN_C void ITTAPI __itt_stack_callee_leave(__itt_caller id)
 {
+  if (UniController::IsThreadIgnored()) {
+    return;
+  }
+
+  // callees are left in the reverse order they are entered
+  if ((id != 0) && !stack_callees.empty()) {
+    stack_callees.pop_back();
+  }
 }
 
 
@@ -0,0 +1,289 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_COUNTER_H_
+#define PTI_TOOLS_UNITRACE_ITT_COUNTER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "utils.h"
+#include "unitimer.h"
+#include "unimemory.h"
+#include "unicontrol.h"
+#include "unievent.h"
+
+#define ITT_COUNTER_SHARDS	64
+#define ITT_COUNTER_SAMPLING_INTERVAL_DEFAULT	1000	// in microseconds
+
+typedef void (*OnIttCounterLoggingCallback)(const char *name, uint64_t ts, IttArgs* value);
+
+// Set in a forked child until a counter is updated, see IttCounterSampler::ChildAfterFork()
+static std::atomic<bool> itt_counter_sampling_pending_{false};
+
+struct alignas(64) IttCounterShard {
+  std::atomic<int64_t> delta_{0};
+};
+
+// An ITT counter. Updates only touch the shard of the calling thread, so threads incrementing
+// the same counter do not contend. __itt_counter_set_value() stores an absolute value and the
+// deltas summed at that moment; the value of the counter is the absolute value plus the
+// deltas made after it.
+struct IttCounter {
+  std::string name_;	// domain::name
+  __itt_metadata_type type_;
+  IttCounterShard shards_[ITT_COUNTER_SHARDS];
+  std::atomic<uint64_t> value_{0};	// raw bits of the last set value
+  std::atomic<int64_t> delta_base_{0};
+  std::atomic<bool> destroyed_{false};
+  bool sampled_ = false;	// owned by the sampler
+  bool last_destroyed_ = false;
+  uint64_t last_value_ = 0;
+  IttCounter *next_ = nullptr;
+
+  static uint32_t GetShard(void) {
+    thread_local uint32_t shard = utils::GetTid() % ITT_COUNTER_SHARDS;
+    return shard;
+  }
+
+  // In a forked child, sampling starts again on the first update
+  static void ResumeSamplingAfterFork(void);
+
+  void Add(int64_t delta) {
+    if (itt_counter_sampling_pending_.load(std::memory_order_relaxed)) {
+      ResumeSamplingAfterFork();
+    }
+    shards_[GetShard()].delta_.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  int64_t SumDeltas(void) const {
+    int64_t sum = 0;
+    for (int i = 0; i < ITT_COUNTER_SHARDS; i++) {
+      sum += shards_[i].delta_.load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+  void Set(const void *value_ptr) {
+    if (itt_counter_sampling_pending_.load(std::memory_order_relaxed)) {
+      ResumeSamplingAfterFork();
+    }
+    uint64_t bits = 0;
+    switch (type_) {
+      case __itt_metadata_s64: bits = (uint64_t)(*(const int64_t *)value_ptr); break;
+      case __itt_metadata_u32: bits = *(const uint32_t *)value_ptr; break;
+      case __itt_metadata_s32: bits = (uint64_t)(int64_t)(*(const int32_t *)value_ptr); break;
+      case __itt_metadata_u16: bits = *(const uint16_t *)value_ptr; break;
+      case __itt_metadata_s16: bits = (uint64_t)(int64_t)(*(const int16_t *)value_ptr); break;
+      case __itt_metadata_float: {
+        double d = *(const float *)value_ptr;
+        memcpy(&bits, &d, sizeof(bits));
+        break;
+      }
+      case __itt_metadata_double: memcpy(&bits, value_ptr, sizeof(bits)); break;
+      default: bits = *(const uint64_t *)value_ptr; break;
+    }
+    delta_base_.store(SumDeltas(), std::memory_order_relaxed);
+    value_.store(bits, std::memory_order_release);
+  }
+
+  // Current value as it is reported: a double for floating point counters and a 64-bit integer otherwise
+  uint64_t Get(void) const {
+    uint64_t bits = value_.load(std::memory_order_acquire);
+    int64_t delta = SumDeltas() - delta_base_.load(std::memory_order_relaxed);
+    if ((type_ == __itt_metadata_float) || (type_ == __itt_metadata_double)) {
+      double d;
+      memcpy(&d, &bits, sizeof(d));
+      d += delta;
+      memcpy(&bits, &d, sizeof(bits));
+      return bits;
+    }
+    return bits + delta;
+  }
+};
+
+// All counters of the process and the thread that samples them.
+// Counter values are written to the trace as Chrome counter events every
+// UNITRACE_ChromeIttCounterInterval microseconds (default 1000), and only when they have changed.
+// Counters are never freed as the application may keep using a handle after destroying it.
+class IttCounterSampler {
+  public:
+    static IttCounter *GetCounter(const char *domain, const char *name, __itt_metadata_type type) {
+      SamplerState& state = GetState();
+      std::string key = std::string((domain != nullptr) ? domain : "") + "::" + ((name != nullptr) ? name : "");
+      std::lock_guard<std::mutex> lock(state.lock_);
+      auto it = state.counters_.find(key);
+      if (it != state.counters_.end()) {
+        // a counter created again after it is destroyed is sampled again
+        it->second->destroyed_.store(false, std::memory_order_release);
+        it->second->last_destroyed_ = false;
+        return it->second;
+      }
+
+      IttCounter *counter = new IttCounter();
+      UniMemory::ExitIfOutOfMemory((void *)counter);
+      counter->name_ = key;
+      counter->type_ = ((type > __itt_metadata_unknown) && (type <= __itt_metadata_double)) ? type : __itt_metadata_u64;
+      counter->next_ = state.counter_list_;
+      state.counter_list_ = counter;
+      state.counters_[key] = counter;
+
+      StartSampling(state);
+      return counter;
+    }
+
+    // Counters of the _v3 entry points are found by their domain and string handle
+    static IttCounter *GetCounter(const __itt_domain *domain, const __itt_string_handle *name) {
+      thread_local std::map<std::pair<const void *, const void *>, IttCounter *> cache;
+      IttCounter *& counter = cache[std::make_pair((const void *)domain, (const void *)name)];
+      if (counter == nullptr) {
+        counter = GetCounter(((domain != nullptr) ? domain->nameA : nullptr), ((name != nullptr) ? name->strA : nullptr), __itt_metadata_u64);
+      }
+      return counter;
+    }
+
+    static void SetCallback(OnIttCounterLoggingCallback callback) {
+      SamplerState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      state.callback_ = callback;
+    }
+
+    // Write the last values and stop the sampling thread
+    static void Stop(void) {
+      SamplerState& state = GetState();
+      std::unique_lock<std::mutex> lock(state.lock_);
+      if (!state.sampler_.joinable()) {
+        return;
+      }
+      state.stopping_ = true;
+      state.wakeup_.notify_all();
+      lock.unlock();
+      state.sampler_.join();
+      lock.lock();
+      state.stopping_ = false;
+    }
+
+    static void PrepareFork(void) {
+      GetState().lock_.lock();
+    }
+
+    static void ParentAfterFork(void) {
+      GetState().lock_.unlock();
+    }
+
+    // The sampling thread does not exist in the child. Counters keep their values. No thread is
+    // started in the handler: the child's first counter update starts sampling again.
+    static void ChildAfterFork(void) {
+      SamplerState& state = GetState();
+      new (&state.lock_) std::mutex();
+      new (&state.wakeup_) std::condition_variable();
+      new (&state.sampler_) std::thread();
+      state.stopping_ = false;
+      for (IttCounter *counter = state.counter_list_; counter != nullptr; counter = counter->next_) {
+        counter->sampled_ = false;
+      }
+      itt_counter_sampling_pending_.store(state.counter_list_ != nullptr, std::memory_order_relaxed);
+    }
+
+    static void StartAfterFork(void) {
+      SamplerState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      if (itt_counter_sampling_pending_.load(std::memory_order_relaxed)) {
+        StartSampling(state);
+        itt_counter_sampling_pending_.store(false, std::memory_order_relaxed);
+      }
+    }
+
+  private:
+    struct SamplerState {
+      std::mutex lock_;
+      std::map<std::string, IttCounter *> counters_;
+      IttCounter *counter_list_ = nullptr;
+      OnIttCounterLoggingCallback callback_ = nullptr;
+      std::thread sampler_;
+      std::condition_variable wakeup_;
+      bool stopping_ = false;
+    };
+
+    // Never destroyed. Counters may be created from library constructors and the sampler
+    // runs until the tool library is finalized, after static objects are destroyed.
+    static SamplerState& GetState(void) {
+      static SamplerState *state = new SamplerState();
+      return *state;
+    }
+
+    // lock is held
+    static void StartSampling(SamplerState& state) {
+      if ((state.callback_ == nullptr) || state.sampler_.joinable()) {
+        return;
+      }
+      state.sampler_ = std::thread(Run);
+    }
+
+    static void Run(void) {
+      SamplerState& state = GetState();
+      auto interval = std::chrono::microseconds(GetInterval());
+      std::unique_lock<std::mutex> lock(state.lock_);
+      while (!state.stopping_) {
+        state.wakeup_.wait_for(lock, interval, [&state] { return state.stopping_; });
+        Sample(state);
+      }
+    }
+
+    // lock is held
+    static void Sample(SamplerState& state) {
+      if (!UniController::IsHostCollectionEnabled()) {
+        return;
+      }
+      uint64_t ts = UniTimer::GetHostTimestamp();
+      for (IttCounter *counter = state.counter_list_; counter != nullptr; counter = counter->next_) {
+        if (counter->last_destroyed_) {
+          continue;
+        }
+        uint64_t value = counter->Get();
+        if (!counter->sampled_ || (value != counter->last_value_)) {
+          IttArgs args;
+          args.count = 1;
+          if ((counter->type_ == __itt_metadata_float) || (counter->type_ == __itt_metadata_double)) {
+            args.type = __itt_metadata_double;
+          } else if ((counter->type_ == __itt_metadata_u64) || (counter->type_ == __itt_metadata_u32) || (counter->type_ == __itt_metadata_u16)) {
+            args.type = __itt_metadata_u64;
+          } else {
+            args.type = __itt_metadata_s64;
+          }
+          args.key = "value";
+          memcpy(args.data, &value, sizeof(value));
+          state.callback_(counter->name_.c_str(), ts, &args);
+          counter->sampled_ = true;
+          counter->last_value_ = value;
+        }
+        // a destroyed counter is sampled one last time
+        counter->last_destroyed_ = counter->destroyed_.load(std::memory_order_acquire);
+      }
+    }
+
+    static uint64_t GetInterval(void) {
+      static uint64_t interval = [] {
+        std::string value = utils::GetEnv("UNITRACE_ChromeIttCounterInterval");
+        long long n = value.empty() ? 0 : std::atoll(value.c_str());
+        return (n > 0) ? (uint64_t)n : (uint64_t)ITT_COUNTER_SAMPLING_INTERVAL_DEFAULT;
+      }();
+      return interval;
+    }
+};
+
+inline void IttCounter::ResumeSamplingAfterFork(void) {
+  IttCounterSampler::StartAfterFork();
+}
+
+#endif // PTI_TOOLS_UNITRACE_ITT_COUNTER_H_
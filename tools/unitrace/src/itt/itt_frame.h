@@ -0,0 +1,238 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_FRAME_H_
+#define PTI_TOOLS_UNITRACE_ITT_FRAME_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "utils.h"
+#include "unimemory.h"
+#include "itt_track.h"
+#include "itt_utils.h"
+
+// Frame times are counted in a log-linear histogram: exact below 64ns and 64 buckets per power of 2
+// above, so percentiles are within 1% of the exact values for any frame time.
+#define ITT_FRAME_HISTOGRAM_SUB_BUCKETS	64
+#define ITT_FRAME_HISTOGRAM_SIZE	((64 - 5) * ITT_FRAME_HISTOGRAM_SUB_BUCKETS)
+
+struct IttFrameDomain {
+  std::string name_;
+  IttVirtualTrack *track_;
+  std::map<std::tuple<unsigned long long, unsigned long long, unsigned long long>, uint64_t> open_frames_;	// start time by frame id
+  uint64_t count_ = 0;
+  uint64_t total_time_ = 0;
+  uint64_t max_time_ = 0;
+  uint64_t over_budget_ = 0;
+  std::vector<uint64_t> histogram_;
+};
+
+// Frames of all domains and their statistics.
+// A frame can begin on one thread and end on another. Frames are per iteration, so a single
+// lock is cheap enough.
+class IttFrames : public IttForkHandlers<IttFrames> {
+  public:
+    static void Begin(const __itt_domain *domain, const __itt_id *id, uint64_t ts) {
+      FrameState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      IttFrameDomain *frames = GetFrameDomain(state, domain);
+      frames->open_frames_[GetKey(id)] = ts;
+    }
+
+    static void End(const __itt_domain *domain, const __itt_id *id, uint64_t ts) {
+      FrameState& state = GetState();
+      IttFrameDomain *frames;
+      uint64_t start;
+      {
+        std::lock_guard<std::mutex> lock(state.lock_);
+        frames = GetFrameDomain(state, domain);
+        auto it = frames->open_frames_.find(GetKey(id));
+        if (it == frames->open_frames_.end()) {
+          return;	// frame end without frame begin
+        }
+        start = it->second;
+        frames->open_frames_.erase(it);
+        AddFrameTime(frames, (ts > start) ? (ts - start) : 0);
+      }
+      IttVirtualTracks::LogSlice(frames->track_, frames->name_.c_str(), start, ts, nullptr);
+    }
+
+    static void Submit(const __itt_domain *domain, uint64_t start, uint64_t end) {
+      FrameState& state = GetState();
+      IttFrameDomain *frames;
+      {
+        std::lock_guard<std::mutex> lock(state.lock_);
+        frames = GetFrameDomain(state, domain);
+        AddFrameTime(frames, (end > start) ? (end - start) : 0);
+      }
+      IttVirtualTracks::LogSlice(frames->track_, frames->name_.c_str(), start, end, nullptr);
+    }
+
+    static std::string SummaryReport(void) {
+      const uint32_t kDomainLength = 10;
+      const uint32_t kCountLength = 12;
+      const uint32_t kTimeLength = 20;
+
+      FrameState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+
+      size_t max_name_length = kDomainLength;
+      bool empty = true;
+      for (auto& value : state.domains_) {
+        if (value.second->count_ > 0) {
+          empty = false;
+          max_name_length = std::max(max_name_length, value.second->name_.size());
+        }
+      }
+      if (empty) {
+        return "";
+      }
+
+      uint64_t budget = GetBudget();
+      std::string budget_title = "Over " + std::to_string(budget / 1000) + " us";
+
+      std::string str;
+      str += IttReportHeader("ITT Frames", rank_mpi);
+
+      str += IttAlign("Domain", max_name_length) + ", " + IttAlign("Frames", kCountLength) + ", " +
+        IttAlign("Mean (ns)", kTimeLength) + ", " + IttAlign("p50 (ns)", kTimeLength) + ", " +
+        IttAlign("p99 (ns)", kTimeLength) + ", " + IttAlign("Max (ns)", kTimeLength);
+      if (budget > 0) {
+        str += ", " + IttAlign(budget_title, kCountLength);
+      }
+      str += "\n";
+
+      for (auto& value : state.domains_) {
+        IttFrameDomain *frames = value.second;
+        if (frames->count_ == 0) {
+          continue;
+        }
+        str += IttAlign(frames->name_, max_name_length) + ", " +
+          IttAlign(std::to_string(frames->count_), kCountLength) + ", " +
+          IttAlign(std::to_string(frames->total_time_ / frames->count_), kTimeLength) + ", " +
+          IttAlign(std::to_string(GetPercentile(frames, 0.50)), kTimeLength) + ", " +
+          IttAlign(std::to_string(GetPercentile(frames, 0.99)), kTimeLength) + ", " +
+          IttAlign(std::to_string(frames->max_time_), kTimeLength);
+        if (budget > 0) {
+          str += ", " + IttAlign(std::to_string(frames->over_budget_), std::max(size_t(kCountLength), budget_title.size()));
+        }
+        str += "\n";
+      }
+      return str;
+    }
+
+  private:
+    friend class IttForkHandlers<IttFrames>;
+
+    // The child reports its own frames only
+    static void ResetAfterFork(void) {
+      FrameState& state = GetState();
+      for (auto& value : state.domains_) {
+        IttFrameDomain *frames = value.second;
+        frames->open_frames_.clear();
+        frames->count_ = 0;
+        frames->total_time_ = 0;
+        frames->max_time_ = 0;
+        frames->over_budget_ = 0;
+        std::fill(frames->histogram_.begin(), frames->histogram_.end(), 0);
+      }
+    }
+
+    struct FrameState {
+      std::mutex lock_;
+      std::map<const __itt_domain *, IttFrameDomain *> domains_;
+    };
+
+    static FrameState& GetState(void) {
+      static FrameState *state = new FrameState();
+      return *state;
+    }
+
+    // frame budget in nanoseconds, 0 if not set
+    static uint64_t GetBudget(void) {
+      static uint64_t budget = [] {
+        std::string value = utils::GetEnv("UNITRACE_IttFrameBudget");
+        double us = value.empty() ? 0.0 : std::atof(value.c_str());
+        return (us > 0.0) ? (uint64_t)(us * 1000.0) : (uint64_t)0;
+      }();
+      return budget;
+    }
+
+    // lock is held
+    static IttFrameDomain *GetFrameDomain(FrameState& state, const __itt_domain *domain) {
+      IttFrameDomain *& frames = state.domains_[domain];
+      if (frames == nullptr) {
+        frames = new IttFrameDomain();
+        UniMemory::ExitIfOutOfMemory((void *)frames);
+        frames->name_ = ((domain != nullptr) && (domain->nameA != nullptr)) ? domain->nameA : "UNNAMED_DOMAIN";
+        frames->track_ = IttVirtualTracks::Create("Frames " + frames->name_);
+        frames->histogram_.resize(ITT_FRAME_HISTOGRAM_SIZE, 0);
+      }
+      return frames;
+    }
+
+    static std::tuple<unsigned long long, unsigned long long, unsigned long long> GetKey(const __itt_id *id) {
+      if (id == nullptr) {
+        return std::make_tuple(__itt_null.d1, __itt_null.d2, __itt_null.d3);
+      }
+      return std::make_tuple(id->d1, id->d2, id->d3);
+    }
+
+    // lock is held
+    static void AddFrameTime(IttFrameDomain *frames, uint64_t time) {
+      frames->count_++;
+      frames->total_time_ += time;
+      if (time > frames->max_time_) {
+        frames->max_time_ = time;
+      }
+      uint64_t budget = GetBudget();
+      if ((budget > 0) && (time > budget)) {
+        frames->over_budget_++;
+      }
+      frames->histogram_[GetBucket(time)]++;
+    }
+
+    static uint32_t GetBucket(uint64_t time) {
+      if (time < ITT_FRAME_HISTOGRAM_SUB_BUCKETS) {
+        return (uint32_t)time;
+      }
+      int e = 63 - __builtin_clzll(time);	// e >= 6
+      return (e - 5) * ITT_FRAME_HISTOGRAM_SUB_BUCKETS + ((time >> (e - 6)) & (ITT_FRAME_HISTOGRAM_SUB_BUCKETS - 1));
+    }
+
+    // middle of the bucket
+    static uint64_t GetBucketTime(uint32_t bucket) {
+      if (bucket < ITT_FRAME_HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+      }
+      int e = bucket / ITT_FRAME_HISTOGRAM_SUB_BUCKETS + 5;
+      uint64_t sub = bucket % ITT_FRAME_HISTOGRAM_SUB_BUCKETS;
+      return ((ITT_FRAME_HISTOGRAM_SUB_BUCKETS + sub) << (e - 6)) + ((1ULL << (e - 6)) >> 1);
+    }
+
+    static uint64_t GetPercentile(const IttFrameDomain *frames, double percentile) {
+      uint64_t rank = (uint64_t)(percentile * frames->count_ + 0.999999);
+      if (rank == 0) {
+        rank = 1;
+      }
+      uint64_t seen = 0;
+      for (uint32_t i = 0; i < ITT_FRAME_HISTOGRAM_SIZE; i++) {
+        seen += frames->histogram_[i];
+        if (seen >= rank) {
+          return std::min(GetBucketTime(i), frames->max_time_);
+        }
+      }
+      return frames->max_time_;
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_FRAME_H_
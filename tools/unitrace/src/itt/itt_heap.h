@@ -0,0 +1,355 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_HEAP_H_
+#define PTI_TOOLS_UNITRACE_ITT_HEAP_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utils.h"
+#include "unimemory.h"
+#include "itt_symbol.h"
+#include "itt_utils.h"
+
+#define ITT_HEAP_SHARDS	16
+#define ITT_HEAP_SAMPLING_INTERVAL_DEFAULT	(64 * 1024)	// in bytes
+#define ITT_HEAP_FILTER_SIZE	(0x1 << 16)	// must be a power of 2
+
+struct alignas(64) IttHeapShard {
+  std::atomic<uint64_t> allocations_{0};
+  std::atomic<uint64_t> frees_{0};
+  std::atomic<uint64_t> reallocations_{0};
+  std::atomic<uint64_t> bytes_{0};
+};
+
+// A heap function, e.g. a memory allocator of a library.
+// Calls and bytes are counted exactly in the shard of the calling thread. Live and peak bytes are
+// estimated from sampled allocations.
+struct IttHeapFunction {
+  std::string name_;	// domain::name
+  IttHeapShard shards_[ITT_HEAP_SHARDS];
+  std::atomic<int64_t> live_bytes_{0};
+  std::atomic<int64_t> peak_bytes_{0};
+
+  static uint32_t GetShard(void) {
+    thread_local uint32_t shard = utils::GetTid() % ITT_HEAP_SHARDS;
+    return shard;
+  }
+
+  uint64_t Sum(std::atomic<uint64_t> IttHeapShard::*counter) const {
+    uint64_t sum = 0;
+    for (int i = 0; i < ITT_HEAP_SHARDS; i++) {
+      sum += (shards_[i].*counter).load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+  void Reset(void) {
+    for (int i = 0; i < ITT_HEAP_SHARDS; i++) {
+      shards_[i].allocations_.store(0, std::memory_order_relaxed);
+      shards_[i].frees_.store(0, std::memory_order_relaxed);
+      shards_[i].reallocations_.store(0, std::memory_order_relaxed);
+      shards_[i].bytes_.store(0, std::memory_order_relaxed);
+    }
+    peak_bytes_.store(live_bytes_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+};
+
+struct IttHeapSample {
+  IttHeapFunction *function_;
+  int64_t weight_;	// bytes the sample stands for
+};
+
+struct IttHeapTaskStats {
+  uint64_t allocations_ = 0;
+  uint64_t bytes_ = 0;
+};
+
+// Allocations of the tasks of a function of __itt_task_begin_fn()
+struct IttHeapFunctionTaskStats {
+  IttHeapTaskStats stats_;
+  uint64_t ts_ = 0;	// start of the first task, to name the function in the modules loaded then
+};
+
+// Heap functions and sampled allocations.
+// Allocated bytes are sampled at random with a mean interval of UNITRACE_IttHeapSamplingInterval
+// bytes (default 65536) per thread, and a sampled allocation stands for the bytes of all allocations
+// like it. Sampled blocks are kept by address until a free or a reallocation of them begins, before
+// the address can be reused by another thread. A counting filter of the sampled addresses lets almost
+// all frees skip the lookup.
+class IttHeapFunctions {
+  public:
+    static IttHeapFunction *Create(const char *name, const char *domain) {
+      HeapState& state = GetState();
+      std::string key = std::string((domain != nullptr) ? domain : "") + "::" + ((name != nullptr) ? name : "");
+      std::lock_guard<std::mutex> lock(state.lock_);
+      IttHeapFunction *& function = state.functions_[key];
+      if (function == nullptr) {
+        function = new IttHeapFunction();
+        UniMemory::ExitIfOutOfMemory((void *)function);
+        function->name_ = key;
+      }
+      return function;
+    }
+
+    static void Allocated(IttHeapFunction *function, void *addr, size_t size) {
+      IttHeapShard& shard = function->shards_[IttHeapFunction::GetShard()];
+      shard.allocations_.fetch_add(1, std::memory_order_relaxed);
+      shard.bytes_.fetch_add(size, std::memory_order_relaxed);
+      Sample(function, addr, size);
+    }
+
+    static void Freed(void *addr) {
+      if (addr == nullptr) {
+        return;
+      }
+      HeapState& state = GetState();
+      size_t hash = Hash(addr);
+      if (state.filter_[hash & (ITT_HEAP_FILTER_SIZE - 1)].load(std::memory_order_relaxed) == 0) {
+        return;	// not sampled
+      }
+      SampleShard& shard = state.samples_[hash % ITT_HEAP_SHARDS];
+      IttHeapSample sample;
+      {
+        std::lock_guard<std::mutex> lock(shard.lock_);
+        auto it = shard.samples_.find(addr);
+        if (it == shard.samples_.end()) {
+          return;
+        }
+        sample = it->second;
+        shard.samples_.erase(it);
+      }
+      state.filter_[hash & (ITT_HEAP_FILTER_SIZE - 1)].fetch_sub(1, std::memory_order_relaxed);
+      sample.function_->live_bytes_.fetch_sub(sample.weight_, std::memory_order_relaxed);
+    }
+
+    static void Free(IttHeapFunction *function) {
+      function->shards_[IttHeapFunction::GetShard()].frees_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The sample of the old block is dropped with Freed() before the block is reallocated
+    static void Reallocated(IttHeapFunction *function, void *new_addr, size_t new_size) {
+      IttHeapShard& shard = function->shards_[IttHeapFunction::GetShard()];
+      shard.reallocations_.fetch_add(1, std::memory_order_relaxed);
+      shard.bytes_.fetch_add(new_size, std::memory_order_relaxed);
+      Sample(function, new_addr, new_size);
+    }
+
+    // Allocations made while a task is open on the thread, added when the task ends
+    static void AddTaskAllocations(const std::string& task, uint64_t allocations, uint64_t bytes) {
+      HeapState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      IttHeapTaskStats& stats = state.tasks_[task];
+      stats.allocations_ += allocations;
+      stats.bytes_ += bytes;
+    }
+
+    // Allocations made while a task of a function is open, by function. The function is named when the
+    // summary is printed.
+    static void AddTaskAllocations(const char *domain, const void *fn, uint64_t ts, uint64_t allocations, uint64_t bytes) {
+      HeapState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      IttHeapFunctionTaskStats& stats = state.function_tasks_[std::make_pair(domain, fn)];
+      if (stats.stats_.allocations_ == 0) {
+        stats.ts_ = ts;
+      }
+      stats.stats_.allocations_ += allocations;
+      stats.stats_.bytes_ += bytes;
+    }
+
+    static std::string SummaryReport(void) {
+      const uint32_t kNameLength = 10;
+      const uint32_t kCountLength = 12;
+      const uint32_t kBytesLength = 20;
+
+      HeapState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+
+      std::map<std::string, IttHeapTaskStats> task_stats = state.tasks_;
+      for (auto& value : state.function_tasks_) {
+        std::string name = std::string(value.first.first) + "::" + IttSymbols::GetName(value.first.second, value.second.ts_);
+        IttHeapTaskStats& stats = task_stats[name];
+        stats.allocations_ += value.second.stats_.allocations_;
+        stats.bytes_ += value.second.stats_.bytes_;
+      }
+
+      size_t max_name_length = kNameLength;
+      std::vector<IttHeapFunction *> functions;
+      for (auto& value : state.functions_) {
+        IttHeapFunction *function = value.second;
+        if ((function->Sum(&IttHeapShard::allocations_) + function->Sum(&IttHeapShard::reallocations_) + function->Sum(&IttHeapShard::frees_)) > 0) {
+          functions.push_back(function);
+          max_name_length = std::max(max_name_length, value.first.size());
+        }
+      }
+      for (auto& value : task_stats) {
+        max_name_length = std::max(max_name_length, value.first.size());
+      }
+      if (functions.empty() && task_stats.empty()) {
+        return "";
+      }
+
+      std::string str;
+      str += IttReportHeader("ITT Heap", rank_mpi);
+
+      if (!functions.empty()) {
+        str += IttAlign("Function", max_name_length) + ", " + IttAlign("Allocations", kCountLength) + ", " +
+          IttAlign("Frees", kCountLength) + ", " + IttAlign("Reallocations", kCountLength) + ", " +
+          IttAlign("Bytes", kBytesLength) + ", " + IttAlign("Live Bytes (est.)", kBytesLength) + ", " +
+          IttAlign("Peak Bytes (est.)", kBytesLength) + "\n";
+        for (auto function : functions) {
+          str += IttAlign(function->name_, max_name_length) + ", " +
+            IttAlign(std::to_string(function->Sum(&IttHeapShard::allocations_)), kCountLength) + ", " +
+            IttAlign(std::to_string(function->Sum(&IttHeapShard::frees_)), kCountLength) + ", " +
+            IttAlign(std::to_string(function->Sum(&IttHeapShard::reallocations_)), kCountLength) + ", " +
+            IttAlign(std::to_string(function->Sum(&IttHeapShard::bytes_)), kBytesLength) + ", " +
+            IttAlign(std::to_string(std::max(function->live_bytes_.load(std::memory_order_relaxed), (int64_t)0)), kBytesLength) + ", " +
+            IttAlign(std::to_string(function->peak_bytes_.load(std::memory_order_relaxed)), kBytesLength) + "\n";
+        }
+      }
+
+      if (!task_stats.empty()) {
+        std::vector<std::pair<std::string, IttHeapTaskStats>> tasks(task_stats.begin(), task_stats.end());
+        std::sort(tasks.begin(), tasks.end(), [](const std::pair<std::string, IttHeapTaskStats>& l, const std::pair<std::string, IttHeapTaskStats>& r) {
+          return l.second.bytes_ > r.second.bytes_;
+        });
+        str += IttAlign("Task", max_name_length) + ", " + IttAlign("Allocations", kCountLength) + ", " + IttAlign("Bytes", kBytesLength) + "\n";
+        for (auto& task : tasks) {
+          str += IttAlign(task.first, max_name_length) + ", " + IttAlign(std::to_string(task.second.allocations_), kCountLength) + ", " +
+            IttAlign(std::to_string(task.second.bytes_), kBytesLength) + "\n";
+        }
+      }
+      return str;
+    }
+
+    static void PrepareFork(void) {
+      HeapState& state = GetState();
+      state.lock_.lock();
+      for (int i = 0; i < ITT_HEAP_SHARDS; i++) {
+        state.samples_[i].lock_.lock();
+      }
+    }
+
+    static void ParentAfterFork(void) {
+      HeapState& state = GetState();
+      for (int i = ITT_HEAP_SHARDS - 1; i >= 0; i--) {
+        state.samples_[i].lock_.unlock();
+      }
+      state.lock_.unlock();
+    }
+
+    // The child reports its own calls only. Blocks allocated by the parent are still live in the child.
+    static void ChildAfterFork(void) {
+      HeapState& state = GetState();
+      new (&state.lock_) std::mutex();
+      for (int i = 0; i < ITT_HEAP_SHARDS; i++) {
+        new (&state.samples_[i].lock_) std::mutex();
+      }
+      for (auto& value : state.functions_) {
+        value.second->Reset();
+      }
+      state.tasks_.clear();
+      state.function_tasks_.clear();
+    }
+
+  private:
+    struct alignas(64) SampleShard {
+      std::mutex lock_;
+      std::unordered_map<void *, IttHeapSample> samples_;
+    };
+
+    struct HeapState {
+      std::mutex lock_;
+      std::map<std::string, IttHeapFunction *> functions_;
+      std::map<std::string, IttHeapTaskStats> tasks_;
+      std::map<std::pair<const char *, const void *>, IttHeapFunctionTaskStats> function_tasks_;
+      SampleShard samples_[ITT_HEAP_SHARDS];
+      std::atomic<uint16_t> filter_[ITT_HEAP_FILTER_SIZE];
+    };
+
+    static HeapState& GetState(void) {
+      static HeapState *state = [] {
+        HeapState *s = new HeapState();
+        for (int i = 0; i < ITT_HEAP_FILTER_SIZE; i++) {
+          s->filter_[i].store(0, std::memory_order_relaxed);
+        }
+        return s;
+      }();
+      return *state;
+    }
+
+    static uint64_t GetSamplingInterval(void) {
+      static uint64_t interval = [] {
+        std::string value = utils::GetEnv("UNITRACE_IttHeapSamplingInterval");
+        long long n = value.empty() ? 0 : std::atoll(value.c_str());
+        return (n > 0) ? (uint64_t)n : (uint64_t)ITT_HEAP_SAMPLING_INTERVAL_DEFAULT;
+      }();
+      return interval;
+    }
+
+    static size_t Hash(void *addr) {
+      uint64_t h = (uint64_t)(uintptr_t)addr * 0x9E3779B97F4A7C15ULL;
+      return (size_t)(h >> 32);
+    }
+
+    // Exponentially distributed number of bytes to the next sample, so that samples do not
+    // follow patterns of the application
+    static int64_t GetBytesToSample(void) {
+      thread_local uint64_t random = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)utils::GetTid() << 16);
+      random ^= random >> 12;
+      random ^= random << 25;
+      random ^= random >> 27;
+      double u = double((random * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);	// [0, 1)
+      return (int64_t)(-std::log(1.0 - u) * GetSamplingInterval()) + 1;
+    }
+
+    static void Sample(IttHeapFunction *function, void *addr, size_t size) {
+      thread_local int64_t bytes_to_sample = GetBytesToSample();
+      bytes_to_sample -= (int64_t)size;
+      if (bytes_to_sample > 0) {
+        return;
+      }
+      bytes_to_sample = GetBytesToSample();
+      if (addr == nullptr) {
+        return;
+      }
+
+      // a block of size bytes is sampled with probability 1 - exp(-size / interval)
+      HeapState& state = GetState();
+      double probability = 1.0 - std::exp(-double(size) / GetSamplingInterval());
+      IttHeapSample sample = {function, (int64_t)(double(size) / probability)};
+      size_t hash = Hash(addr);
+      SampleShard& shard = state.samples_[hash % ITT_HEAP_SHARDS];
+      {
+        std::lock_guard<std::mutex> lock(shard.lock_);
+        auto it = shard.samples_.find(addr);
+        if (it != shard.samples_.end()) {
+          // the block was freed without the free being reported
+          it->second.function_->live_bytes_.fetch_sub(it->second.weight_, std::memory_order_relaxed);
+          it->second = sample;
+        } else {
+          shard.samples_.emplace(addr, sample);
+          state.filter_[hash & (ITT_HEAP_FILTER_SIZE - 1)].fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      int64_t live = function->live_bytes_.fetch_add(sample.weight_, std::memory_order_relaxed) + sample.weight_;
+      int64_t peak = function->peak_bytes_.load(std::memory_order_relaxed);
+      while ((live > peak) && !function->peak_bytes_.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+      }
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_HEAP_H_
@@ -0,0 +1,327 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_HISTOGRAM_H_
+#define PTI_TOOLS_UNITRACE_ITT_HISTOGRAM_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utils.h"
+#include "unitimer.h"
+#include "unimemory.h"
+#include "unievent.h"
+#include "itt_track.h"
+#include "itt_utils.h"
+
+// Value i of an array of the given ITT type, converted to T
+template <typename T>
+static T IttGetTypedValue(const void *data, __itt_metadata_type type, size_t i) {
+  switch (type) {
+    case __itt_metadata_u64: return (T)((const uint64_t *)data)[i];
+    case __itt_metadata_s64: return (T)((const int64_t *)data)[i];
+    case __itt_metadata_u32: return (T)((const uint32_t *)data)[i];
+    case __itt_metadata_s32: return (T)((const int32_t *)data)[i];
+    case __itt_metadata_u16: return (T)((const uint16_t *)data)[i];
+    case __itt_metadata_s16: return (T)((const int16_t *)data)[i];
+    case __itt_metadata_float: return (T)((const float *)data)[i];
+    case __itt_metadata_double: return (T)((const double *)data)[i];
+    default: return (T)0;
+  }
+}
+
+// Type of the accumulator of values of an ITT type
+static __itt_metadata_type IttGetAccumulatorType(__itt_metadata_type type) {
+  switch (type) {
+    case __itt_metadata_s64:
+    case __itt_metadata_s32:
+    case __itt_metadata_s16:
+      return __itt_metadata_s64;
+    case __itt_metadata_float:
+    case __itt_metadata_double:
+      return __itt_metadata_double;
+    default:
+      return __itt_metadata_u64;
+  }
+}
+
+static const char *IttGetTypeName(__itt_metadata_type type) {
+  switch (type) {
+    case __itt_metadata_u64: return "u64";
+    case __itt_metadata_s64: return "s64";
+    case __itt_metadata_u32: return "u32";
+    case __itt_metadata_s32: return "s32";
+    case __itt_metadata_u16: return "u16";
+    case __itt_metadata_s16: return "s16";
+    case __itt_metadata_float: return "float";
+    case __itt_metadata_double: return "double";
+    default: return "unknown";
+  }
+}
+
+// An ITT histogram. Submissions are merged into the sum of y for each x.
+class IttHistogramBase {
+  public:
+    IttHistogramBase(const std::string& name, __itt_metadata_type x_type, __itt_metadata_type y_type) : name_(name), x_type_(x_type), y_type_(y_type) {
+    }
+
+    virtual ~IttHistogramBase() {
+    }
+
+    // x_data is nullptr if x is the index of y, y_data is nullptr if each x is counted once
+    virtual void Submit(size_t length, const void *x_data, const void *y_data) = 0;
+
+    // Bins as "x":[...],"y":[...] arguments of an event, or nullptr if the histogram is empty
+    virtual IttArgs *GetArgs(void) = 0;
+
+    virtual std::string GetTable(void) = 0;
+
+    virtual void Reset(void) = 0;
+
+    const std::string& GetName(void) const { return name_; }
+
+    std::mutex lock_;
+
+  protected:
+    std::string name_;	// domain::name
+    __itt_metadata_type x_type_;
+    __itt_metadata_type y_type_;
+};
+
+template <typename X, typename Y>
+class IttTypedHistogram : public IttHistogramBase {
+  public:
+    using IttHistogramBase::IttHistogramBase;
+
+    void Submit(size_t length, const void *x_data, const void *y_data) override {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (x_data == nullptr) {
+        // dense bins, no lookup per value
+        if (indexed_bins_.size() < length) {
+          indexed_bins_.resize(length, 0);
+        }
+        for (size_t i = 0; i < length; i++) {
+          indexed_bins_[i] += (y_data != nullptr) ? IttGetTypedValue<Y>(y_data, y_type_, i) : (Y)1;
+        }
+        return;
+      }
+      for (size_t i = 0; i < length; i++) {
+        bins_[IttGetTypedValue<X>(x_data, x_type_, i)] += (y_data != nullptr) ? IttGetTypedValue<Y>(y_data, y_type_, i) : (Y)1;
+      }
+    }
+
+    IttArgs *GetArgs(void) override {
+      std::vector<std::pair<X, Y>> bins = GetBins();
+      if (bins.empty()) {
+        return nullptr;
+      }
+
+      size_t count = bins.size();
+      IttArgs *args = (IttArgs *)malloc(sizeof(IttArgs));
+      UniMemory::ExitIfOutOfMemory((void *)args);
+      X *x = (X *)malloc(std::max(count * sizeof(X), sizeof(void *)));
+      UniMemory::ExitIfOutOfMemory((void *)x);
+      IttArgs *y_args = (IttArgs *)malloc(std::max(count * sizeof(Y), sizeof(void *)) + sizeof(IttArgs) - sizeof(void *));
+      UniMemory::ExitIfOutOfMemory((void *)y_args);
+      Y *y = (Y *)y_args->data;
+      for (size_t i = 0; i < count; i++) {
+        x[i] = bins[i].first;
+        y[i] = bins[i].second;
+      }
+
+      // same layout as arguments of __itt_metadata_add(): the first array is indirect and the others follow their headers
+      args->key = "x";
+      args->type = IttGetAccumulatorType(x_type_);
+      args->count = count;
+      args->isIndirectData = true;
+      args->data[0] = x;
+      args->next = y_args;
+      y_args->key = "y";
+      y_args->type = IttGetAccumulatorType(y_type_);
+      y_args->count = count;
+      y_args->isIndirectData = false;
+      y_args->next = nullptr;
+      return args;
+    }
+
+    std::string GetTable(void) override {
+      const uint32_t kValueLength = 20;
+
+      std::vector<std::pair<X, Y>> bins = GetBins();
+      if (bins.empty()) {
+        return "";
+      }
+      std::string str = name_ + " (x: " + IttGetTypeName(x_type_) + ", y: " + IttGetTypeName(y_type_) + ")\n";
+      str += IttAlign("x", kValueLength) + ", " + IttAlign("y", kValueLength) + "\n";
+      for (auto& bin : bins) {
+        str += IttAlign(std::to_string(bin.first), kValueLength) + ", " + IttAlign(std::to_string(bin.second), kValueLength) + "\n";
+      }
+      return str;
+    }
+
+    void Reset(void) override {
+      bins_.clear();
+      indexed_bins_.clear();
+    }
+
+  private:
+    std::vector<std::pair<X, Y>> GetBins(void) {
+      std::lock_guard<std::mutex> lock(lock_);
+      std::map<X, Y> bins = bins_;
+      for (size_t i = 0; i < indexed_bins_.size(); i++) {
+        if (indexed_bins_[i] != 0) {
+          bins[(X)i] += indexed_bins_[i];
+        }
+      }
+      return std::vector<std::pair<X, Y>>(bins.begin(), bins.end());
+    }
+
+    std::map<X, Y> bins_;
+    std::vector<Y> indexed_bins_;
+};
+
+// All histograms of the process.
+// The bins are written once, when the tool is finalized: to the trace as the arguments of an event on the
+// track "Histograms", and to the report as a table.
+class IttHistograms {
+  public:
+    static __itt_histogram *Create(const __itt_domain *domain, const char *name, __itt_metadata_type x_type, __itt_metadata_type y_type) {
+      HistogramState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      for (__itt_histogram *hist = state.histogram_list_; hist != nullptr; hist = hist->next) {
+        if ((hist->domain == domain) && (hist->nameA != nullptr) && (name != nullptr) && !strcmp(hist->nameA, name)) {
+          return hist;
+        }
+      }
+
+      __itt_histogram *hist = (__itt_histogram *)malloc(sizeof(__itt_histogram));
+      UniMemory::ExitIfOutOfMemory((void *)hist);
+      hist->domain = domain;
+      hist->nameA = (name != nullptr) ? strdup(name) : nullptr;
+      hist->nameW = nullptr;
+      hist->x_type = x_type;
+      hist->y_type = y_type;
+      hist->extra1 = 0;
+      std::string full_name = std::string(((domain != nullptr) && (domain->nameA != nullptr)) ? domain->nameA : "") + "::" + ((name != nullptr) ? name : "");
+      hist->extra2 = CreateTyped(full_name, x_type, y_type);
+      hist->next = state.histogram_list_;
+      state.histogram_list_ = hist;
+      return hist;
+    }
+
+    static void Submit(__itt_histogram *hist, size_t length, const void *x_data, const void *y_data) {
+      if ((hist == nullptr) || (hist->extra2 == nullptr) || (length == 0)) {
+        return;
+      }
+      ((IttHistogramBase *)hist->extra2)->Submit(length, x_data, y_data);
+    }
+
+    // Write the bins of all histograms to the trace
+    static void Log(void) {
+      if (!IttVirtualTracks::IsLoggingOn()) {
+        return;
+      }
+      HistogramState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      uint64_t ts = UniTimer::GetHostTimestamp();
+      for (__itt_histogram *hist = state.histogram_list_; hist != nullptr; hist = hist->next) {
+        IttHistogramBase *histogram = (IttHistogramBase *)hist->extra2;
+        IttArgs *args = histogram->GetArgs();
+        if (args != nullptr) {
+          if (state.track_ == nullptr) {
+            state.track_ = IttVirtualTracks::Create("Histograms");
+          }
+          IttVirtualTracks::LogSlice(state.track_, histogram->GetName().c_str(), ts, ts, args);
+          free(args);	// the arrays are owned by the event now
+        }
+      }
+    }
+
+    static std::string SummaryReport(void) {
+      HistogramState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      std::string tables;
+      for (__itt_histogram *hist = state.histogram_list_; hist != nullptr; hist = hist->next) {
+        tables += ((IttHistogramBase *)hist->extra2)->GetTable();
+      }
+      if (tables.empty()) {
+        return "";
+      }
+
+      std::string str;
+      str += IttReportHeader("ITT Histograms", rank_mpi);
+      str += tables;
+      return str;
+    }
+
+    static void PrepareFork(void) {
+      HistogramState& state = GetState();
+      state.lock_.lock();
+      for (__itt_histogram *hist = state.histogram_list_; hist != nullptr; hist = hist->next) {
+        ((IttHistogramBase *)hist->extra2)->lock_.lock();
+      }
+    }
+
+    static void ParentAfterFork(void) {
+      HistogramState& state = GetState();
+      for (__itt_histogram *hist = state.histogram_list_; hist != nullptr; hist = hist->next) {
+        ((IttHistogramBase *)hist->extra2)->lock_.unlock();
+      }
+      state.lock_.unlock();
+    }
+
+    // The child reports its own submissions only
+    static void ChildAfterFork(void) {
+      HistogramState& state = GetState();
+      new (&state.lock_) std::mutex();
+      state.track_ = nullptr;
+      for (__itt_histogram *hist = state.histogram_list_; hist != nullptr; hist = hist->next) {
+        IttHistogramBase *histogram = (IttHistogramBase *)hist->extra2;
+        new (&histogram->lock_) std::mutex();
+        histogram->Reset();
+      }
+    }
+
+  private:
+    struct HistogramState {
+      std::mutex lock_;
+      __itt_histogram *histogram_list_ = nullptr;
+      IttVirtualTrack *track_ = nullptr;
+    };
+
+    static HistogramState& GetState(void) {
+      static HistogramState *state = new HistogramState();
+      return *state;
+    }
+
+    template <typename X>
+    static IttHistogramBase *CreateTyped(const std::string& name, __itt_metadata_type x_type, __itt_metadata_type y_type) {
+      IttHistogramBase *histogram;
+      switch (IttGetAccumulatorType(y_type)) {
+        case __itt_metadata_s64: histogram = new IttTypedHistogram<X, int64_t>(name, x_type, y_type); break;
+        case __itt_metadata_double: histogram = new IttTypedHistogram<X, double>(name, x_type, y_type); break;
+        default: histogram = new IttTypedHistogram<X, uint64_t>(name, x_type, y_type); break;
+      }
+      UniMemory::ExitIfOutOfMemory((void *)histogram);
+      return histogram;
+    }
+
+    static IttHistogramBase *CreateTyped(const std::string& name, __itt_metadata_type x_type, __itt_metadata_type y_type) {
+      switch (IttGetAccumulatorType(x_type)) {
+        case __itt_metadata_s64: return CreateTyped<int64_t>(name, x_type, y_type);
+        case __itt_metadata_double: return CreateTyped<double>(name, x_type, y_type);
+        default: return CreateTyped<uint64_t>(name, x_type, y_type);
+      }
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_HISTOGRAM_H_
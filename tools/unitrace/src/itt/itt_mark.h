@@ -0,0 +1,215 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_MARK_H_
+#define PTI_TOOLS_UNITRACE_ITT_MARK_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+#include "unimemory.h"
+#include "unievent.h"
+#include "itt_utils.h"
+
+#define ITT_MARK_TYPES	1024
+
+typedef void (*OnIttMarkLoggingCallback)(uint32_t tid, const char *name, uint64_t ts, bool global, IttArgs* metadata_args);
+
+// Marks of one type and the times between them, on all threads
+struct IttMarkType {
+  std::string name_;
+  std::string off_name_;
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> first_time_{0};
+  std::atomic<uint64_t> last_time_{0};
+  std::atomic<uint64_t> interval_time_{0};	// sum of the times between marks
+  std::atomic<uint64_t> min_interval_{UINT64_MAX};
+  std::atomic<uint64_t> max_interval_{0};
+
+  void Reset(void) {
+    count_.store(0, std::memory_order_relaxed);
+    first_time_.store(0, std::memory_order_relaxed);
+    last_time_.store(0, std::memory_order_relaxed);
+    interval_time_.store(0, std::memory_order_relaxed);
+    min_interval_.store(UINT64_MAX, std::memory_order_relaxed);
+    max_interval_.store(0, std::memory_order_relaxed);
+  }
+};
+
+// Mark types of __itt_mark_create(). A mark type is the index of the type in the table plus 1, so
+// marks look up their types without locking. 0 is not a mark type.
+class IttMarks : public IttForkHandlers<IttMarks> {
+  public:
+    static __itt_mark_type Create(const char *name) {
+      if (name == nullptr) {
+        return 0;
+      }
+      MarkState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      uint32_t num_types = state.num_types_.load(std::memory_order_relaxed);
+      for (uint32_t i = 0; i < num_types; i++) {
+        if (state.types_[i].load(std::memory_order_relaxed)->name_ == name) {
+          return i + 1;
+        }
+      }
+      if (num_types == ITT_MARK_TYPES) {
+        return 0;
+      }
+
+      IttMarkType *type = new IttMarkType();
+      UniMemory::ExitIfOutOfMemory((void *)type);
+      type->name_ = name;
+      type->off_name_ = type->name_ + " (off)";
+      state.types_[num_types].store(type, std::memory_order_release);
+      state.num_types_.store(num_types + 1, std::memory_order_release);
+      return num_types + 1;
+    }
+
+    static IttMarkType *Get(__itt_mark_type mt) {
+      if ((mt <= 0) || (mt > ITT_MARK_TYPES)) {
+        return nullptr;
+      }
+      return GetState().types_[mt - 1].load(std::memory_order_acquire);
+    }
+
+    static void Mark(IttMarkType *type, uint64_t ts) {
+      type->count_.fetch_add(1, std::memory_order_relaxed);
+      uint64_t first = 0;
+      type->first_time_.compare_exchange_strong(first, ts, std::memory_order_relaxed);
+      uint64_t last = type->last_time_.exchange(ts, std::memory_order_relaxed);
+      if ((last == 0) || (ts <= last)) {
+        return;
+      }
+
+      uint64_t interval = ts - last;
+      type->interval_time_.fetch_add(interval, std::memory_order_relaxed);
+      uint64_t min = type->min_interval_.load(std::memory_order_relaxed);
+      while ((interval < min) && !type->min_interval_.compare_exchange_weak(min, interval, std::memory_order_relaxed)) {
+      }
+      uint64_t max = type->max_interval_.load(std::memory_order_relaxed);
+      while ((interval > max) && !type->max_interval_.compare_exchange_weak(max, interval, std::memory_order_relaxed)) {
+      }
+    }
+
+    // Instant event of the mark, with the parameter as argument
+    static void Log(uint32_t tid, const char *name, uint64_t ts, bool global, const char *parameter) {
+      OnIttMarkLoggingCallback callback = GetState().callback_;
+      if (callback == nullptr) {
+        return;
+      }
+
+      IttArgs args;
+      args.count = 0;
+      args.next = nullptr;
+      if ((parameter != nullptr) && (parameter[0] != 0)) {
+        size_t length = strlen(parameter);
+        args.key = "parameter";
+        args.type = __itt_metadata_unknown;
+        args.count = length;
+        if (length > sizeof(void *)) {
+          args.data[0] = malloc(length);
+          UniMemory::ExitIfOutOfMemory(args.data[0]);
+          args.isIndirectData = true;
+          memcpy(args.data[0], parameter, length);
+        }
+        else {
+          args.isIndirectData = false;
+          memcpy(args.data, parameter, length);
+        }
+      }
+      callback(tid, name, ts, global, &args);
+    }
+
+    static void SetCallback(OnIttMarkLoggingCallback callback) {
+      GetState().callback_ = callback;
+    }
+
+    static std::string SummaryReport(void) {
+      const uint32_t kMarkLength = 10;
+      const uint32_t kCountLength = 12;
+      const uint32_t kRateLength = 14;
+      const uint32_t kTimeLength = 20;
+
+      MarkState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+
+      std::vector<IttMarkType *> sorted;
+      size_t max_name_length = kMarkLength;
+      uint32_t num_types = state.num_types_.load(std::memory_order_relaxed);
+      for (uint32_t i = 0; i < num_types; i++) {
+        IttMarkType *type = state.types_[i].load(std::memory_order_relaxed);
+        if (type->count_.load(std::memory_order_relaxed) > 0) {
+          sorted.push_back(type);
+          max_name_length = std::max(max_name_length, type->name_.size());
+        }
+      }
+      if (sorted.empty()) {
+        return "";
+      }
+      std::sort(sorted.begin(), sorted.end(), [](const IttMarkType *l, const IttMarkType *r) {
+        return l->count_.load(std::memory_order_relaxed) > r->count_.load(std::memory_order_relaxed);
+      });
+
+      std::string str;
+      str += IttReportHeader("ITT Marks", rank_mpi);
+
+      str += IttAlign("Mark", max_name_length) + ", " + IttAlign("Count", kCountLength) + ", " +
+        IttAlign("Rate (/s)", kRateLength) + ", " + IttAlign("Interval (ns)", kTimeLength) + ", " +
+        IttAlign("Min Interval (ns)", kTimeLength) + ", " + IttAlign("Max Interval (ns)", kTimeLength) + "\n";
+
+      for (auto type : sorted) {
+        uint64_t count = type->count_.load(std::memory_order_relaxed);
+        uint64_t span = type->last_time_.load(std::memory_order_relaxed) - type->first_time_.load(std::memory_order_relaxed);
+        uint64_t min = type->min_interval_.load(std::memory_order_relaxed);
+        std::string rate = "0";
+        std::string interval = "0";
+        if ((count > 1) && (span > 0)) {
+          rate = std::to_string((uint64_t)((double)(count - 1) * 1000000000.0 / (double)span));
+          interval = std::to_string(type->interval_time_.load(std::memory_order_relaxed) / (count - 1));
+        }
+        str += IttAlign(type->name_, max_name_length) + ", " +
+          IttAlign(std::to_string(count), kCountLength) + ", " +
+          IttAlign(rate, kRateLength) + ", " +
+          IttAlign(interval, kTimeLength) + ", " +
+          IttAlign(std::to_string((min == UINT64_MAX) ? 0 : min), kTimeLength) + ", " +
+          IttAlign(std::to_string(type->max_interval_.load(std::memory_order_relaxed)), kTimeLength) + "\n";
+      }
+      return str;
+    }
+
+  private:
+    friend class IttForkHandlers<IttMarks>;
+
+    // The child reports its own marks only. Mark types are kept.
+    static void ResetAfterFork(void) {
+      MarkState& state = GetState();
+      uint32_t num_types = state.num_types_.load(std::memory_order_relaxed);
+      for (uint32_t i = 0; i < num_types; i++) {
+        state.types_[i].load(std::memory_order_relaxed)->Reset();
+      }
+    }
+
+    struct MarkState {
+      std::mutex lock_;	// serializes creation of mark types
+      std::atomic<uint32_t> num_types_{0};
+      std::atomic<IttMarkType *> types_[ITT_MARK_TYPES] = {};
+      OnIttMarkLoggingCallback callback_ = nullptr;
+    };
+
+    static MarkState& GetState(void) {
+      static MarkState *state = new MarkState();
+      return *state;
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_MARK_H_
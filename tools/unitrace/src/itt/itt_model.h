@@ -0,0 +1,329 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_MODEL_H_
+#define PTI_TOOLS_UNITRACE_ITT_MODEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.h"
+#include "unimemory.h"
+#include "itt_utils.h"
+
+#define ITT_MODEL_UNNAMED	"UNNAMED_SITE"
+
+// Times of all instances of a site of the same name
+struct IttModelSiteStats {
+  std::string name_;
+  std::atomic<uint64_t> instances_{0};
+  std::atomic<uint64_t> site_time_{0};	// serial time of the instances
+  std::atomic<uint64_t> tasks_{0};
+  std::atomic<uint64_t> task_time_{0};
+  std::atomic<uint64_t> max_task_time_{0};
+  std::atomic<uint64_t> lock_time_{0};	// time in critical sections of the tasks
+  std::atomic<uint64_t> projected_time_{0};	// time of the instances if the tasks ran in parallel
+
+  void Reset(void) {
+    instances_.store(0, std::memory_order_relaxed);
+    site_time_.store(0, std::memory_order_relaxed);
+    tasks_.store(0, std::memory_order_relaxed);
+    task_time_.store(0, std::memory_order_relaxed);
+    max_task_time_.store(0, std::memory_order_relaxed);
+    lock_time_.store(0, std::memory_order_relaxed);
+    projected_time_.store(0, std::memory_order_relaxed);
+  }
+};
+
+// Sites, tasks and locks of the __itt_model_*() annotations of a serial program.
+// A site instance is timed by the thread that runs it, and its tasks and locks are accounted on the thread
+// without locking. Nested tasks are part of their outermost task. When the instance ends, its time if the
+// tasks ran on N threads is projected as the time outside the tasks plus the longest of the task time
+// divided by N, the longest task and the longest time in the critical sections of one lock. N is
+// UNITRACE_IttModelThreads, or the number of hardware threads by default.
+// Instances are tracked while collection is paused, so begins and ends keep matching, but only an instance
+// that begins and ends while collecting is accounted.
+class IttModelSites : public IttForkHandlers<IttModelSites> {
+  public:
+    static void SiteBegin(const char *name, size_t length, uint64_t ts, bool accounted) {
+      SiteInstance instance;
+      if (accounted) {
+        std::string site = (name != nullptr) ? ((length != std::string::npos) ? std::string(name, length) : std::string(name)) : "";
+        instance.stats_ = GetStats(site.empty() ? ITT_MODEL_UNNAMED : site);
+      }
+      instance.start_time_ = ts;
+      GetThreadSites().push_back(std::move(instance));
+    }
+
+    static void SiteEnd(uint64_t ts, bool accounted) {
+      std::vector<SiteInstance>& sites = GetThreadSites();
+      if (sites.empty()) {
+        return;
+      }
+      SiteInstance& instance = sites.back();
+      if (instance.iteration_) {
+        EndTask(instance, ts);
+      }
+      if (instance.task_depth_ > 0) {	// tasks not ended end with the site
+        instance.task_depth_ = 1;
+        EndTask(instance, ts);
+      }
+      if (!accounted || (instance.stats_ == nullptr)) {
+        sites.pop_back();
+        return;
+      }
+
+      uint64_t site_time = (ts > instance.start_time_) ? (ts - instance.start_time_) : 0;
+      uint64_t serial_time = (site_time > instance.task_time_) ? (site_time - instance.task_time_) : 0;
+      uint64_t max_lock_time = 0;
+      for (auto& value : instance.locks_) {
+        max_lock_time = std::max(max_lock_time, value.second.hold_time_);
+      }
+      uint64_t parallel_time = std::max({instance.task_time_ / GetThreads(), instance.max_task_time_, max_lock_time});
+
+      IttModelSiteStats *stats = instance.stats_;
+      stats->instances_.fetch_add(1, std::memory_order_relaxed);
+      stats->site_time_.fetch_add(site_time, std::memory_order_relaxed);
+      stats->tasks_.fetch_add(instance.tasks_, std::memory_order_relaxed);
+      stats->task_time_.fetch_add(instance.task_time_, std::memory_order_relaxed);
+      stats->lock_time_.fetch_add(instance.lock_time_, std::memory_order_relaxed);
+      stats->projected_time_.fetch_add(serial_time + std::min(parallel_time, instance.task_time_), std::memory_order_relaxed);
+      uint64_t max = stats->max_task_time_.load(std::memory_order_relaxed);
+      while ((instance.max_task_time_ > max) && !stats->max_task_time_.compare_exchange_weak(max, instance.max_task_time_, std::memory_order_relaxed)) {
+      }
+      sites.pop_back();
+    }
+
+    static void TaskBegin(uint64_t ts) {
+      std::vector<SiteInstance>& sites = GetThreadSites();
+      if (!sites.empty() && (sites.back().task_depth_++ == 0)) {
+        sites.back().task_start_time_ = ts;
+      }
+    }
+
+    static void TaskEnd(uint64_t ts) {
+      std::vector<SiteInstance>& sites = GetThreadSites();
+      if (!sites.empty() && (sites.back().task_depth_ > 0)) {
+        EndTask(sites.back(), ts);
+      }
+    }
+
+    // An iteration task ends when the next iteration begins or the site ends
+    static void IterationTask(uint64_t ts) {
+      std::vector<SiteInstance>& sites = GetThreadSites();
+      if (sites.empty()) {
+        return;
+      }
+      SiteInstance& instance = sites.back();
+      if (instance.iteration_) {
+        EndTask(instance, ts);
+      }
+      if (instance.task_depth_ == 0) {
+        instance.iteration_ = true;
+        instance.task_depth_ = 1;
+        instance.task_start_time_ = ts;
+      }
+    }
+
+    // Only locks in tasks are accounted. A lock acquired again before it is released is held once.
+    static void LockAcquire(void *lock, uint64_t ts) {
+      std::vector<SiteInstance>& sites = GetThreadSites();
+      if (sites.empty() || (sites.back().task_depth_ == 0)) {
+        return;
+      }
+      SiteInstance& instance = sites.back();
+      LockTimes& times = instance.locks_[lock];
+      if (times.depth_++ == 0) {
+        times.acquired_time_ = ts;
+        if (instance.locks_held_++ == 0) {
+          instance.lock_start_time_ = ts;
+        }
+      }
+    }
+
+    static void LockRelease(void *lock, uint64_t ts) {
+      std::vector<SiteInstance>& sites = GetThreadSites();
+      if (sites.empty()) {
+        return;
+      }
+      SiteInstance& instance = sites.back();
+      auto it = instance.locks_.find(lock);
+      if ((it == instance.locks_.end()) || (it->second.depth_ == 0)) {
+        return;
+      }
+      ReleaseLock(instance, it->second, ts);
+    }
+
+    static std::string SummaryReport(void) {
+      const uint32_t kSiteLength = 10;
+      const uint32_t kCountLength = 12;
+      const uint32_t kTimeLength = 20;
+      const uint32_t kSpeedupLength = 14;
+
+      ModelState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+
+      std::vector<IttModelSiteStats *> sorted;
+      size_t max_name_length = kSiteLength;
+      for (auto& value : state.stats_) {
+        if (value.second->instances_.load(std::memory_order_relaxed) > 0) {
+          sorted.push_back(value.second);
+          max_name_length = std::max(max_name_length, value.first.size());
+        }
+      }
+      if (sorted.empty()) {
+        return "";
+      }
+      std::sort(sorted.begin(), sorted.end(), [](const IttModelSiteStats *l, const IttModelSiteStats *r) {
+        return l->site_time_.load(std::memory_order_relaxed) > r->site_time_.load(std::memory_order_relaxed);
+      });
+
+      std::string str;
+      str += IttReportHeader("ITT Model Sites", rank_mpi);
+
+      std::string speedup_header = "Speedup @ " + std::to_string(GetThreads());
+      str += IttAlign("Site", max_name_length) + ", " + IttAlign("Instances", kCountLength) + ", " +
+        IttAlign("Site Time (ns)", kTimeLength) + ", " + IttAlign("Tasks", kCountLength) + ", " +
+        IttAlign("Task Time (ns)", kTimeLength) + ", " + IttAlign("Mean Task (ns)", kTimeLength) + ", " +
+        IttAlign("Max Task (ns)", kTimeLength) + ", " + IttAlign("Lock Time (ns)", kTimeLength) + ", " +
+        IttAlign(speedup_header, kSpeedupLength) + "\n";
+
+      for (auto stats : sorted) {
+        uint64_t site_time = stats->site_time_.load(std::memory_order_relaxed);
+        uint64_t tasks = stats->tasks_.load(std::memory_order_relaxed);
+        uint64_t task_time = stats->task_time_.load(std::memory_order_relaxed);
+        uint64_t projected_time = stats->projected_time_.load(std::memory_order_relaxed);
+        char speedup[32];
+        snprintf(speedup, sizeof(speedup), "%.2f", (projected_time > 0) ? ((double)site_time / (double)projected_time) : 1.0);
+        str += IttAlign(stats->name_, max_name_length) + ", " +
+          IttAlign(std::to_string(stats->instances_.load(std::memory_order_relaxed)), kCountLength) + ", " +
+          IttAlign(std::to_string(site_time), kTimeLength) + ", " +
+          IttAlign(std::to_string(tasks), kCountLength) + ", " +
+          IttAlign(std::to_string(task_time), kTimeLength) + ", " +
+          IttAlign(std::to_string((tasks > 0) ? (task_time / tasks) : 0), kTimeLength) + ", " +
+          IttAlign(std::to_string(stats->max_task_time_.load(std::memory_order_relaxed)), kTimeLength) + ", " +
+          IttAlign(std::to_string(stats->lock_time_.load(std::memory_order_relaxed)), kTimeLength) + ", " +
+          IttAlign(speedup, kSpeedupLength) + "\n";
+      }
+      return str;
+    }
+
+  private:
+    friend class IttForkHandlers<IttModelSites>;
+
+    // The child reports its own sites only
+    static void ResetAfterFork(void) {
+      ModelState& state = GetState();
+      for (auto& value : state.stats_) {
+        value.second->Reset();
+      }
+    }
+
+    struct LockTimes {
+      uint32_t depth_ = 0;
+      uint64_t acquired_time_ = 0;
+      uint64_t hold_time_ = 0;	// in the instance
+    };
+
+    struct SiteInstance {
+      IttModelSiteStats *stats_ = nullptr;
+      uint64_t start_time_ = 0;
+      uint32_t task_depth_ = 0;
+      bool iteration_ = false;	// the task is an iteration task
+      uint64_t task_start_time_ = 0;
+      uint64_t tasks_ = 0;
+      uint64_t task_time_ = 0;
+      uint64_t max_task_time_ = 0;
+      uint32_t locks_held_ = 0;
+      uint64_t lock_start_time_ = 0;
+      uint64_t lock_time_ = 0;	// time any lock is held
+      std::unordered_map<void *, LockTimes> locks_;
+    };
+
+    struct ModelState {
+      std::mutex lock_;	// protects stats_ only
+      std::map<std::string, IttModelSiteStats *> stats_;
+    };
+
+    static ModelState& GetState(void) {
+      static ModelState *state = new ModelState();
+      return *state;
+    }
+
+    static std::vector<SiteInstance>& GetThreadSites(void) {
+      thread_local std::vector<SiteInstance> sites;
+      return sites;
+    }
+
+    static uint64_t GetThreads(void) {
+      static uint64_t threads = [] {
+        std::string value = utils::GetEnv("UNITRACE_IttModelThreads");
+        long n = value.empty() ? 0 : std::atol(value.c_str());
+        if (n <= 0) {
+          n = std::thread::hardware_concurrency();
+        }
+        return (n > 0) ? (uint64_t)n : (uint64_t)1;
+      }();
+      return threads;
+    }
+
+    static void ReleaseLock(SiteInstance& instance, LockTimes& times, uint64_t ts) {
+      if (--times.depth_ > 0) {
+        return;
+      }
+      times.hold_time_ += (ts > times.acquired_time_) ? (ts - times.acquired_time_) : 0;
+      if (--instance.locks_held_ == 0) {
+        instance.lock_time_ += (ts > instance.lock_start_time_) ? (ts - instance.lock_start_time_) : 0;
+      }
+    }
+
+    // The outermost task ends with the locks it holds
+    static void EndTask(SiteInstance& instance, uint64_t ts) {
+      instance.iteration_ = false;
+      if (--instance.task_depth_ > 0) {
+        return;
+      }
+      for (auto& value : instance.locks_) {
+        if (value.second.depth_ > 0) {
+          value.second.depth_ = 1;
+          ReleaseLock(instance, value.second, ts);
+        }
+      }
+      uint64_t task_time = (ts > instance.task_start_time_) ? (ts - instance.task_start_time_) : 0;
+      instance.tasks_++;
+      instance.task_time_ += task_time;
+      instance.max_task_time_ = std::max(instance.max_task_time_, task_time);
+    }
+
+    static IttModelSiteStats *GetStats(const std::string& name) {
+      thread_local std::unordered_map<std::string, IttModelSiteStats *> sites;	// stats are never freed
+      auto it = sites.find(name);
+      if (it != sites.end()) {
+        return it->second;
+      }
+      ModelState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      IttModelSiteStats *& stats = state.stats_[name];
+      if (stats == nullptr) {
+        stats = new IttModelSiteStats();
+        UniMemory::ExitIfOutOfMemory((void *)stats);
+        stats->name_ = name;
+      }
+      sites[name] = stats;
+      return stats;
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_MODEL_H_
@@ -0,0 +1,212 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_MODULE_H_
+#define PTI_TOOLS_UNITRACE_ITT_MODULE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "unicontrol.h"
+#include "unimemory.h"
+#include "unievent.h"
+#include "unitimer.h"
+#include "itt_mark.h"
+#include "itt_track.h"
+#include "itt_utils.h"
+
+// Code range of a module reported with __itt_module_load*(). Modules are never freed, so a range
+// that is unloaded and reused by another module still resolves to the module of the time.
+struct IttModule {
+  std::string name_;	// path of the module, and name of the section if loaded with sections
+  uintptr_t start_;
+  uintptr_t end_;
+  uint64_t load_time_;
+  uint64_t unload_time_;	// UINT64_MAX while loaded
+  const __itt_module_object *object_;	// nullptr if loaded without sections
+};
+
+class IttModules : public IttForkHandlers<IttModules> {
+  public:
+    static void Load(const void *start_addr, const void *end_addr, const char *path, const __itt_module_object *object = nullptr) {
+      if ((uintptr_t)end_addr <= (uintptr_t)start_addr) {
+        return;
+      }
+      IttModule *module = new IttModule();
+      UniMemory::ExitIfOutOfMemory((void *)module);
+      module->name_ = (path != nullptr) ? path : "";
+      module->start_ = (uintptr_t)start_addr;
+      module->end_ = (uintptr_t)end_addr;
+      module->load_time_ = UniTimer::GetHostTimestamp();
+      module->unload_time_ = UINT64_MAX;
+      module->object_ = object;
+      {
+        ModuleState& state = GetState();
+        std::lock_guard<std::mutex> lock(state.lock_);
+        state.modules_.emplace(module->start_, module);
+        state.max_length_ = std::max(state.max_length_, module->end_ - module->start_);
+      }
+      Log("Module Load", module, module->load_time_);
+    }
+
+    static void LoadSections(const __itt_module_object *object) {
+      if (object == nullptr) {
+        return;
+      }
+      std::string path = (object->module_name != nullptr) ? object->module_name : "";
+      for (unsigned int i = 0; i < object->section_number; i++) {
+        const __itt_section_info& section = object->section_array[i];
+        if ((section.start_addr == nullptr) || (section.size == 0)) {
+          continue;
+        }
+        std::string name = path;
+        if (section.name != nullptr) {
+          name = name + ":" + section.name;
+        }
+        Load(section.start_addr, (const char *)section.start_addr + section.size, name.c_str(), object);
+      }
+    }
+
+    // Unloads the loaded module that contains the address
+    static void Unload(const void *addr) {
+      uint64_t ts = UniTimer::GetHostTimestamp();
+      IttModule *module;
+      {
+        ModuleState& state = GetState();
+        std::lock_guard<std::mutex> lock(state.lock_);
+        module = Find(state, (uintptr_t)addr, ts);
+        if (module == nullptr) {
+          return;
+        }
+        module->unload_time_ = ts;
+      }
+      Log("Module Unload", module, ts);
+    }
+
+    static void UnloadSections(const __itt_module_object *object) {
+      if (object == nullptr) {
+        return;
+      }
+      uint64_t ts = UniTimer::GetHostTimestamp();
+      std::vector<IttModule *> unloaded;
+      {
+        ModuleState& state = GetState();
+        std::lock_guard<std::mutex> lock(state.lock_);
+        for (auto& value : state.modules_) {
+          if ((value.second->object_ == object) && (value.second->unload_time_ == UINT64_MAX)) {
+            value.second->unload_time_ = ts;
+            unloaded.push_back(value.second);
+          }
+        }
+      }
+      for (auto module : unloaded) {
+        Log("Module Unload", module, ts);
+      }
+    }
+
+    // "<module>+0x<offset>" if the address was in a module at the given time, empty otherwise
+    static std::string GetName(const void *addr, uint64_t ts) {
+      ModuleState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      IttModule *module = Find(state, (uintptr_t)addr, ts);
+      if (module == nullptr) {
+        return "";
+      }
+      char str[32];
+      snprintf(str, sizeof(str), "+0x%llx", (unsigned long long)((uintptr_t)addr - module->start_));
+      return module->name_ + str;
+    }
+
+    static void SetCallback(OnIttMarkLoggingCallback callback) {
+      GetState().callback_ = callback;
+    }
+
+  private:
+    friend class IttForkHandlers<IttModules>;
+
+    struct ModuleState {
+      std::mutex lock_;
+      std::multimap<uintptr_t, IttModule *> modules_;	// by start address
+      uintptr_t max_length_ = 0;	// longest code range, bounds the modules that can contain an address
+      std::atomic<IttVirtualTrack *> track_{nullptr};
+      OnIttMarkLoggingCallback callback_ = nullptr;
+    };
+
+    static ModuleState& GetState(void) {
+      static ModuleState *state = new ModuleState();
+      return *state;
+    }
+
+    // Modules starting more than the longest code range below the address cannot contain it, so only the
+    // ranges reused over time around the address are walked
+    static IttModule *Find(ModuleState& state, uintptr_t addr, uint64_t ts) {
+      auto it = state.modules_.upper_bound(addr);
+      while (it != state.modules_.begin()) {
+        --it;
+        IttModule *module = it->second;
+        if (addr - module->start_ >= state.max_length_) {
+          break;
+        }
+        if ((addr < module->end_) && (module->load_time_ <= ts) && (ts < module->unload_time_)) {
+          return module;
+        }
+      }
+      return nullptr;
+    }
+
+    // Instant event on the "Modules" track with the path and the code range as arguments. The modules are
+    // mapped even if the event is not logged, so functions of tasks logged later still resolve against them.
+    static void Log(const char *name, const IttModule *module, uint64_t ts) {
+      ModuleState& state = GetState();
+      if (state.callback_ == nullptr) {
+        return;
+      }
+      if (!UniController::IsHostCollectionEnabled()) {	// ignored thread or paused collection
+        return;
+      }
+      IttVirtualTrack *track = state.track_.load(std::memory_order_acquire);
+      if (track == nullptr) {	// let it race, the track of the same name is returned
+        track = IttVirtualTracks::Get("Modules");
+        state.track_.store(track, std::memory_order_release);
+      }
+
+      // same layout as arguments of __itt_metadata_add(): the first argument is indirect and the others follow their headers
+      IttArgs args;
+      size_t length = module->name_.size();
+      args.key = "path";
+      args.type = __itt_metadata_unknown;
+      args.count = length;
+      args.isIndirectData = true;
+      args.data[0] = malloc(std::max(length, (size_t)1));
+      UniMemory::ExitIfOutOfMemory(args.data[0]);
+      memcpy(args.data[0], module->name_.c_str(), length);
+      args.next = NewAddressArg("start_address", module->start_, NewAddressArg("end_address", module->end_, nullptr));
+      state.callback_(IttVirtualTracks::GetTid(track), name, ts, false, &args);
+    }
+
+    static IttArgs *NewAddressArg(const char *key, uintptr_t addr, IttArgs *next) {
+      IttArgs *args = (IttArgs *)malloc(sizeof(IttArgs));
+      UniMemory::ExitIfOutOfMemory((void *)args);
+      uint64_t value = addr;
+      args->key = key;
+      args->type = __itt_metadata_u64;
+      args->count = 1;
+      args->isIndirectData = false;
+      memcpy(args->data, &value, sizeof(value));
+      args->next = next;
+      return args;
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_MODULE_H_
@@ -0,0 +1,253 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_MPI_H_
+#define PTI_TOOLS_UNITRACE_ITT_MPI_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.h"
+#include "unimemory.h"
+#include "itt_utils.h"
+
+#define ITT_MPI_DENSE_PEERS	4096	// peers of lower ranks are counted without locking
+
+// Messages exchanged with one peer rank
+struct IttMpiPeerStats {
+  std::atomic<uint64_t> sent_messages_{0};
+  std::atomic<uint64_t> sent_bytes_{0};
+  std::atomic<uint64_t> received_messages_{0};
+  std::atomic<uint64_t> received_bytes_{0};
+
+  void Reset(void) {
+    sent_messages_.store(0, std::memory_order_relaxed);
+    sent_bytes_.store(0, std::memory_order_relaxed);
+    received_messages_.store(0, std::memory_order_relaxed);
+    received_bytes_.store(0, std::memory_order_relaxed);
+  }
+};
+
+// Progress of the calls of one MPI function reported by __itt_task_end_internal_callback_info()
+struct IttMpiFunctionStats {
+  std::string name_;
+  std::atomic<uint64_t> calls_{0};
+  std::atomic<uint64_t> iterations_{0};	// iterations of the progress engine
+  std::atomic<uint64_t> max_iterations_{0};
+  std::atomic<uint64_t> bytes_{0};
+
+  void Reset(void) {
+    calls_.store(0, std::memory_order_relaxed);
+    iterations_.store(0, std::memory_order_relaxed);
+    max_iterations_.store(0, std::memory_order_relaxed);
+    bytes_.store(0, std::memory_order_relaxed);
+  }
+};
+
+// The row of this rank in the communication matrix of the job, from the message sizes and ranks
+// reported by __itt_task_end_internal_ex_info(). A side of the message is counted if its rank is
+// valid and its size is not 0. The rows in the logs of all ranks make the matrix.
+// The progress of MPI functions reported by __itt_task_end_internal_callback_info() is also summarized.
+class IttMpiMessages : public IttForkHandlers<IttMpiMessages> {
+  public:
+    static void Add(size_t src_size, int src_location, size_t dst_size, int dst_location) {
+      if ((src_location >= 0) && (src_size > 0)) {
+        IttMpiPeerStats *stats = GetStats(src_location);
+        stats->received_messages_.fetch_add(1, std::memory_order_relaxed);
+        stats->received_bytes_.fetch_add(src_size, std::memory_order_relaxed);
+      }
+      if ((dst_location >= 0) && (dst_size > 0)) {
+        IttMpiPeerStats *stats = GetStats(dst_location);
+        stats->sent_messages_.fetch_add(1, std::memory_order_relaxed);
+        stats->sent_bytes_.fetch_add(dst_size, std::memory_order_relaxed);
+      }
+    }
+
+    static void AddProgress(const std::string& name, int64_t mpi_counter, size_t src_size, size_t dst_size) {
+      thread_local std::unordered_map<std::string, IttMpiFunctionStats *> functions;	// stats are never freed
+      IttMpiFunctionStats *stats;
+      auto it = functions.find(name);
+      if (it != functions.end()) {
+        stats = it->second;
+      }
+      else {
+        stats = GetFunctionStats(name);
+        functions[name] = stats;
+      }
+
+      uint64_t iterations = (mpi_counter > 0) ? mpi_counter : 0;
+      stats->calls_.fetch_add(1, std::memory_order_relaxed);
+      stats->iterations_.fetch_add(iterations, std::memory_order_relaxed);
+      stats->bytes_.fetch_add(src_size + dst_size, std::memory_order_relaxed);
+      uint64_t max = stats->max_iterations_.load(std::memory_order_relaxed);
+      while ((iterations > max) && !stats->max_iterations_.compare_exchange_weak(max, iterations, std::memory_order_relaxed)) {
+      }
+    }
+
+    static std::string SummaryReport(void) {
+      return MessageReport() + ProgressReport();
+    }
+
+  private:
+    friend class IttForkHandlers<IttMpiMessages>;
+
+    // The child reports its own messages and calls only
+    static void ResetAfterFork(void) {
+      MpiState& state = GetState();
+      for (int rank = 0; rank < ITT_MPI_DENSE_PEERS; rank++) {
+        state.dense_[rank].Reset();
+      }
+      for (auto& value : state.sparse_) {
+        value.second->Reset();
+      }
+      for (auto& value : state.functions_) {
+        value.second->Reset();
+      }
+    }
+
+    struct MpiState {
+      IttMpiPeerStats dense_[ITT_MPI_DENSE_PEERS];
+      std::mutex lock_;	// protects sparse_ and functions_
+      std::map<int, IttMpiPeerStats *> sparse_;	// peers of higher ranks
+      std::map<std::string, IttMpiFunctionStats *> functions_;
+    };
+
+    static MpiState& GetState(void) {
+      static MpiState *state = new MpiState();
+      return *state;
+    }
+
+    static std::string MessageReport(void) {
+      const uint32_t kRankLength = 10;
+      const uint32_t kCountLength = 18;
+      const uint32_t kBytesLength = 20;
+
+      MpiState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+
+      std::map<int, IttMpiPeerStats *> peers;
+      for (int rank = 0; rank < ITT_MPI_DENSE_PEERS; rank++) {
+        if (IsUsed(state.dense_[rank])) {
+          peers[rank] = &state.dense_[rank];
+        }
+      }
+      for (auto& value : state.sparse_) {
+        if (IsUsed(*value.second)) {
+          peers[value.first] = value.second;
+        }
+      }
+      if (peers.empty()) {
+        return "";
+      }
+
+      std::string str;
+      str += IttReportHeader("ITT MPI Messages", rank_mpi);
+
+      str += IttAlign("Peer Rank", kRankLength) + ", " + IttAlign("Sent Messages", kCountLength) + ", " +
+        IttAlign("Sent Bytes", kBytesLength) + ", " + IttAlign("Received Messages", kCountLength) + ", " +
+        IttAlign("Received Bytes", kBytesLength) + "\n";
+
+      for (auto& value : peers) {
+        IttMpiPeerStats *stats = value.second;
+        str += IttAlign(std::to_string(value.first), kRankLength) + ", " +
+          IttAlign(std::to_string(stats->sent_messages_.load(std::memory_order_relaxed)), kCountLength) + ", " +
+          IttAlign(std::to_string(stats->sent_bytes_.load(std::memory_order_relaxed)), kBytesLength) + ", " +
+          IttAlign(std::to_string(stats->received_messages_.load(std::memory_order_relaxed)), kCountLength) + ", " +
+          IttAlign(std::to_string(stats->received_bytes_.load(std::memory_order_relaxed)), kBytesLength) + "\n";
+      }
+      return str;
+    }
+
+    static std::string ProgressReport(void) {
+      const uint32_t kFunctionLength = 10;
+      const uint32_t kCountLength = 16;
+      const uint32_t kBytesLength = 20;
+
+      MpiState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+
+      std::vector<IttMpiFunctionStats *> sorted;
+      size_t max_name_length = kFunctionLength;
+      for (auto& value : state.functions_) {
+        if (value.second->calls_.load(std::memory_order_relaxed) > 0) {
+          sorted.push_back(value.second);
+          max_name_length = std::max(max_name_length, value.first.size());
+        }
+      }
+      if (sorted.empty()) {
+        return "";
+      }
+      std::sort(sorted.begin(), sorted.end(), [](const IttMpiFunctionStats *l, const IttMpiFunctionStats *r) {
+        return l->iterations_.load(std::memory_order_relaxed) > r->iterations_.load(std::memory_order_relaxed);
+      });
+
+      std::string str;
+      str += IttReportHeader("ITT MPI Progress", rank_mpi);
+
+      str += IttAlign("Function", max_name_length) + ", " + IttAlign("Calls", kCountLength) + ", " +
+        IttAlign("Iterations", kCountLength) + ", " + IttAlign("Iterations/Call", kCountLength) + ", " +
+        IttAlign("Max Iterations", kCountLength) + ", " + IttAlign("Bytes", kBytesLength) + ", " +
+        IttAlign("Bytes/Call", kBytesLength) + "\n";
+
+      for (auto stats : sorted) {
+        uint64_t calls = stats->calls_.load(std::memory_order_relaxed);
+        uint64_t iterations = stats->iterations_.load(std::memory_order_relaxed);
+        uint64_t bytes = stats->bytes_.load(std::memory_order_relaxed);
+        str += IttAlign(stats->name_, max_name_length) + ", " +
+          IttAlign(std::to_string(calls), kCountLength) + ", " +
+          IttAlign(std::to_string(iterations), kCountLength) + ", " +
+          IttAlign(std::to_string(iterations / calls), kCountLength) + ", " +
+          IttAlign(std::to_string(stats->max_iterations_.load(std::memory_order_relaxed)), kCountLength) + ", " +
+          IttAlign(std::to_string(bytes), kBytesLength) + ", " +
+          IttAlign(std::to_string(bytes / calls), kBytesLength) + "\n";
+      }
+      return str;
+    }
+
+    static IttMpiFunctionStats *GetFunctionStats(const std::string& name) {
+      MpiState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      auto it = state.functions_.find(name);
+      if (it != state.functions_.end()) {
+        return it->second;
+      }
+      IttMpiFunctionStats *stats = new IttMpiFunctionStats();
+      UniMemory::ExitIfOutOfMemory((void *)stats);
+      stats->name_ = name;
+      state.functions_[name] = stats;
+      return stats;
+    }
+
+    static IttMpiPeerStats *GetStats(int rank) {
+      MpiState& state = GetState();
+      if (rank < ITT_MPI_DENSE_PEERS) {
+        return &state.dense_[rank];
+      }
+      std::lock_guard<std::mutex> lock(state.lock_);
+      auto it = state.sparse_.find(rank);
+      if (it != state.sparse_.end()) {
+        return it->second;
+      }
+      IttMpiPeerStats *stats = new IttMpiPeerStats();
+      UniMemory::ExitIfOutOfMemory((void *)stats);
+      state.sparse_[rank] = stats;
+      return stats;
+    }
+
+    static bool IsUsed(const IttMpiPeerStats& stats) {
+      return ((stats.sent_messages_.load(std::memory_order_relaxed) > 0) ||
+              (stats.received_messages_.load(std::memory_order_relaxed) > 0));
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_MPI_H_
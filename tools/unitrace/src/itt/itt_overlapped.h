@@ -0,0 +1,120 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_OVERLAPPED_H_
+#define PTI_TOOLS_UNITRACE_ITT_OVERLAPPED_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "itt_region.h"
+
+#define ITT_OVERLAPPED_TASK_SHARDS	64
+
+struct IttOverlappedTask {
+  std::string name_;	// domain::name
+  uint64_t async_id_;
+  uint64_t start_time_;
+};
+
+// Overlapped tasks of all threads.
+// An overlapped task may begin on one thread and end on another, and tasks of the same thread need
+// not nest. Open tasks are kept in a map keyed by (domain, id) and split into shards, so threads
+// working on different tasks rarely contend. A task is shown as a pair of Chrome async events.
+class IttOverlappedTasks {
+  public:
+    static void SetCallback(OnIttAsyncLoggingCallback callback) {
+      GetState().callback_ = callback;
+    }
+
+    static void Begin(const __itt_domain *domain, const __itt_id& id, const __itt_string_handle *name, uint64_t ts) {
+      OverlappedState& state = GetState();
+      IttOverlappedTask task;
+      task.name_ = ((domain != nullptr) && (domain->nameA != nullptr)) ? domain->nameA : "";
+      task.name_ += "::";
+      if ((name != nullptr) && (name->strA != nullptr)) {
+        task.name_ += name->strA;
+      }
+      task.async_id_ = IttNewAsyncId();
+      task.start_time_ = ts;
+
+      IttIdKey key(domain, id);
+      OverlappedShard& shard = state.shards_[IttIdKeyHash()(key) % ITT_OVERLAPPED_TASK_SHARDS];
+      {
+        std::lock_guard<std::mutex> lock(shard.lock_);
+        shard.tasks_[key] = task;	// a task begun again with the same id replaces the old one
+      }
+      if (state.callback_ != nullptr) {
+        state.callback_(task.name_.c_str(), task.async_id_, ts, true);
+      }
+    }
+
+    // Returns false if the task is not open
+    static bool End(const __itt_domain *domain, const __itt_id& id, uint64_t ts, IttOverlappedTask& task) {
+      OverlappedState& state = GetState();
+      IttIdKey key(domain, id);
+      OverlappedShard& shard = state.shards_[IttIdKeyHash()(key) % ITT_OVERLAPPED_TASK_SHARDS];
+      {
+        std::lock_guard<std::mutex> lock(shard.lock_);
+        auto it = shard.tasks_.find(key);
+        if (it == shard.tasks_.end()) {
+          return false;
+        }
+        task = std::move(it->second);
+        shard.tasks_.erase(it);
+      }
+      if (state.callback_ != nullptr) {
+        state.callback_(task.name_.c_str(), task.async_id_, ts, false);
+      }
+      return true;
+    }
+
+    static void PrepareFork(void) {
+      OverlappedState& state = GetState();
+      for (int i = 0; i < ITT_OVERLAPPED_TASK_SHARDS; i++) {
+        state.shards_[i].lock_.lock();
+      }
+    }
+
+    static void ParentAfterFork(void) {
+      OverlappedState& state = GetState();
+      for (int i = ITT_OVERLAPPED_TASK_SHARDS - 1; i >= 0; i--) {
+        state.shards_[i].lock_.unlock();
+      }
+    }
+
+    // Tasks begun in the parent are not ended in the trace of the child
+    static void ChildAfterFork(void) {
+      OverlappedState& state = GetState();
+      for (int i = 0; i < ITT_OVERLAPPED_TASK_SHARDS; i++) {
+        new (&state.shards_[i].lock_) std::mutex();
+        state.shards_[i].tasks_.clear();
+      }
+    }
+
+  private:
+    struct alignas(64) OverlappedShard {
+      std::mutex lock_;
+      std::unordered_map<IttIdKey, IttOverlappedTask, IttIdKeyHash> tasks_;
+    };
+
+    struct OverlappedState {
+      OverlappedShard shards_[ITT_OVERLAPPED_TASK_SHARDS];
+      OnIttAsyncLoggingCallback callback_ = nullptr;
+    };
+
+    static OverlappedState& GetState(void) {
+      static OverlappedState *state = new OverlappedState();
+      return *state;
+    }
+};
+
+typedef IttIntervalTimes<IttOverlappedTasks> IttOverlappedTaskTimes;
+
+#endif // PTI_TOOLS_UNITRACE_ITT_OVERLAPPED_H_
@@ -0,0 +1,236 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_REGION_H_
+#define PTI_TOOLS_UNITRACE_ITT_REGION_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "unimemory.h"
+#include "itt_utils.h"
+
+typedef void (*OnIttAsyncLoggingCallback)(const char *name, uint64_t id, uint64_t ts, bool begin);
+
+// Id of the Chrome async events of a region or an overlapped task. ITT ids may be reused once an
+// instance ends, so every instance gets an id of its own.
+static inline uint64_t IttNewAsyncId(void) {
+  static std::atomic<uint64_t> next_async_id{1};
+  return next_async_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+// An ITT instance (region, overlapped task, ...) is identified by its domain and id
+struct IttIdKey {
+  const __itt_domain *domain_;
+  unsigned long long d1_;
+  unsigned long long d2_;
+  unsigned long long d3_;
+
+  IttIdKey(const __itt_domain *domain, const __itt_id& id) : domain_(domain), d1_(id.d1), d2_(id.d2), d3_(id.d3) {
+  }
+
+  bool operator==(const IttIdKey& r) const {
+    return (domain_ == r.domain_) && (d1_ == r.d1_) && (d2_ == r.d2_) && (d3_ == r.d3_);
+  }
+};
+
+struct IttIdKeyHash {
+  size_t operator()(const IttIdKey& key) const {
+    uint64_t h = (uint64_t)(uintptr_t)key.domain_;
+    h = (h ^ key.d1_) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ key.d2_) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ key.d3_) * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h ^ (h >> 32));
+  }
+};
+
+// Times of all instances of the same name
+struct IttIntervalStats {
+  std::string name_;
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> total_time_{0};
+  std::atomic<uint64_t> min_time_{UINT64_MAX};
+  std::atomic<uint64_t> max_time_{0};
+
+  void Reset(void) {
+    count_.store(0, std::memory_order_relaxed);
+    total_time_.store(0, std::memory_order_relaxed);
+    min_time_.store(UINT64_MAX, std::memory_order_relaxed);
+    max_time_.store(0, std::memory_order_relaxed);
+  }
+};
+
+// Times of the instances of Owner, e.g. regions, summarized per "<domain>::<name>" at exit.
+// A thread finds the stats of a name it has seen before without locking.
+template <typename Owner>
+class IttIntervalTimes : public IttForkHandlers<IttIntervalTimes<Owner>> {
+  public:
+    static void Add(const std::string& name, uint64_t time) {
+      IttIntervalStats *stats = GetStats(name);
+      stats->count_.fetch_add(1, std::memory_order_relaxed);
+      stats->total_time_.fetch_add(time, std::memory_order_relaxed);
+      uint64_t min = stats->min_time_.load(std::memory_order_relaxed);
+      while ((time < min) && !stats->min_time_.compare_exchange_weak(min, time, std::memory_order_relaxed)) {
+      }
+      uint64_t max = stats->max_time_.load(std::memory_order_relaxed);
+      while ((time > max) && !stats->max_time_.compare_exchange_weak(max, time, std::memory_order_relaxed)) {
+      }
+    }
+
+    static std::string SummaryReport(const std::string& title) {
+      const uint32_t kNameLength = 8;
+      const uint32_t kCountLength = 12;
+      const uint32_t kTimeLength = 20;
+
+      TimesState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+
+      std::vector<IttIntervalStats *> sorted;
+      size_t max_name_length = kNameLength;
+      for (auto& value : state.stats_) {
+        if (value.second->count_.load(std::memory_order_relaxed) > 0) {
+          sorted.push_back(value.second);
+          max_name_length = std::max(max_name_length, value.first.size());
+        }
+      }
+      if (sorted.empty()) {
+        return "";
+      }
+      std::sort(sorted.begin(), sorted.end(), [](const IttIntervalStats *l, const IttIntervalStats *r) {
+        return l->total_time_.load(std::memory_order_relaxed) > r->total_time_.load(std::memory_order_relaxed);
+      });
+
+      std::string str;
+      str += IttReportHeader(title, rank_mpi);
+      str += IttAlign("Name", max_name_length) + ", " + IttAlign("Calls", kCountLength) + ", " +
+        IttAlign("Total Time (ns)", kTimeLength) + ", " + IttAlign("Mean (ns)", kTimeLength) + ", " +
+        IttAlign("Min (ns)", kTimeLength) + ", " + IttAlign("Max (ns)", kTimeLength) + "\n";
+      for (auto stats : sorted) {
+        uint64_t count = stats->count_.load(std::memory_order_relaxed);
+        uint64_t total_time = stats->total_time_.load(std::memory_order_relaxed);
+        str += IttAlign(stats->name_, max_name_length) + ", " +
+          IttAlign(std::to_string(count), kCountLength) + ", " +
+          IttAlign(std::to_string(total_time), kTimeLength) + ", " +
+          IttAlign(std::to_string(total_time / count), kTimeLength) + ", " +
+          IttAlign(std::to_string(stats->min_time_.load(std::memory_order_relaxed)), kTimeLength) + ", " +
+          IttAlign(std::to_string(stats->max_time_.load(std::memory_order_relaxed)), kTimeLength) + "\n";
+      }
+      return str;
+    }
+
+  private:
+    friend class IttForkHandlers<IttIntervalTimes<Owner>>;
+
+    // The child reports its own instances only
+    static void ResetAfterFork(void) {
+      for (auto& value : GetState().stats_) {
+        value.second->Reset();
+      }
+    }
+
+    struct TimesState {
+      std::mutex lock_;	// protects stats_ only
+      std::map<std::string, IttIntervalStats *> stats_;
+    };
+
+    static TimesState& GetState(void) {
+      static TimesState *state = new TimesState();
+      return *state;
+    }
+
+    static IttIntervalStats *GetStats(const std::string& name) {
+      thread_local std::unordered_map<std::string, IttIntervalStats *> names;	// stats are never freed
+      auto it = names.find(name);
+      if (it != names.end()) {
+        return it->second;
+      }
+      TimesState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      IttIntervalStats *& stats = state.stats_[name];
+      if (stats == nullptr) {
+        stats = new IttIntervalStats();
+        UniMemory::ExitIfOutOfMemory((void *)stats);
+        stats->name_ = name;
+      }
+      names[name] = stats;
+      return stats;
+    }
+};
+
+struct IttRegionDescriptor {
+  std::string name_;	// domain::name
+  uint64_t async_id_;	// 0 if the region is not logged
+  uint64_t start_time_;
+};
+
+// Open regions of the calling thread.
+// Regions may end in any order, so they are matched by id instead of kept on a stack. Regions with the
+// same id, e.g. __itt_null, nest. Regions of different threads, or regions of the same thread that do
+// not nest, overlap, so a region is shown as a pair of Chrome async events rather than as a slice.
+class IttRegions {
+  public:
+    static void SetCallback(OnIttAsyncLoggingCallback callback) {
+      GetCallback() = callback;
+    }
+
+    static void Begin(const __itt_domain *domain, const __itt_id& id, const __itt_string_handle *name, uint64_t ts) {
+      IttRegionDescriptor desc;
+      desc.name_ = ((domain != nullptr) && (domain->nameA != nullptr)) ? domain->nameA : "";
+      desc.name_ += "::";
+      if ((name != nullptr) && (name->strA != nullptr)) {
+        desc.name_ += name->strA;
+      }
+      desc.async_id_ = 0;
+      desc.start_time_ = ts;
+      OnIttAsyncLoggingCallback callback = GetCallback();
+      if (callback != nullptr) {
+        desc.async_id_ = IttNewAsyncId();
+        callback(desc.name_.c_str(), desc.async_id_, ts, true);
+      }
+      GetOpenRegions()[IttIdKey(domain, id)].push_back(std::move(desc));
+    }
+
+    // Returns false if the region is not open on this thread
+    static bool End(const __itt_domain *domain, const __itt_id& id, uint64_t ts, IttRegionDescriptor& desc) {
+      auto& regions = GetOpenRegions();
+      auto it = regions.find(IttIdKey(domain, id));
+      if (it == regions.end()) {
+        return false;
+      }
+      desc = std::move(it->second.back());
+      it->second.pop_back();
+      if (it->second.empty()) {
+        regions.erase(it);
+      }
+      OnIttAsyncLoggingCallback callback = GetCallback();
+      if ((callback != nullptr) && (desc.async_id_ != 0)) {
+        callback(desc.name_.c_str(), desc.async_id_, ts, false);
+      }
+      return true;
+    }
+
+  private:
+    static std::unordered_map<IttIdKey, std::vector<IttRegionDescriptor>, IttIdKeyHash>& GetOpenRegions(void) {
+      thread_local std::unordered_map<IttIdKey, std::vector<IttRegionDescriptor>, IttIdKeyHash> regions;
+      return regions;
+    }
+
+    static OnIttAsyncLoggingCallback& GetCallback(void) {
+      static OnIttAsyncLoggingCallback callback = nullptr;
+      return callback;
+    }
+};
+
+typedef IttIntervalTimes<IttRegions> IttRegionTimes;
+
+#endif // PTI_TOOLS_UNITRACE_ITT_REGION_H_
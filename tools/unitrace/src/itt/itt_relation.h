@@ -0,0 +1,155 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_RELATION_H_
+#define PTI_TOOLS_UNITRACE_ITT_RELATION_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "utils.h"
+#include "itt_region.h"
+
+#define ITT_TASK_REGISTRY_SHARDS	64
+
+typedef void (*OnIttRelationLoggingCallback)(uint64_t from_task, uint64_t to_task, const char *relation);
+
+// Where and when a task with an id ran
+struct IttTaskSpan {
+  uint32_t tid_;
+  uint64_t start_time_;
+  uint64_t end_time_;	// 0 while the task is running
+};
+
+// Tasks that may be related to other tasks, by the hash of their domain and id.
+// Relations are logged as pairs of task keys and resolved to threads and timestamps when the trace is
+// written, so a relation may be added before the related task begins. Tasks are kept after their ids are
+// destroyed because the trace is usually written later; a reused id replaces the task.
+class IttTaskRegistry {
+  public:
+    static uint64_t GetKey(const __itt_domain *domain, const __itt_id& id) {
+      uint64_t key = (uint64_t)IttIdKeyHash()(IttIdKey(domain, id));
+      return (key != 0) ? key : 1;	// 0 is no task
+    }
+
+    // Key of a task without an id
+    static uint64_t GetUniqueKey(void) {
+      static std::atomic<unsigned long long> next_id{1};
+      __itt_id id = {next_id.fetch_add(1, std::memory_order_relaxed), 0, (unsigned long long)-1};
+      return GetKey(nullptr, id);
+    }
+
+    // tid is the thread or the virtual track the task is logged on
+    static void Begin(uint64_t key, uint32_t tid, uint64_t ts) {
+      RegistryShard& shard = GetState().shards_[key % ITT_TASK_REGISTRY_SHARDS];
+      std::lock_guard<std::mutex> lock(shard.lock_);
+      shard.tasks_[key] = {tid, ts, 0};
+    }
+
+    static void End(uint64_t key, uint64_t ts) {
+      RegistryShard& shard = GetState().shards_[key % ITT_TASK_REGISTRY_SHARDS];
+      std::lock_guard<std::mutex> lock(shard.lock_);
+      auto it = shard.tasks_.find(key);
+      if (it != shard.tasks_.end()) {
+        it->second.end_time_ = ts;
+      }
+    }
+
+    // end_ts is 0 if the task is still running
+    static bool Lookup(uint64_t key, uint32_t& tid, uint64_t& start_ts, uint64_t& end_ts) {
+      RegistryShard& shard = GetState().shards_[key % ITT_TASK_REGISTRY_SHARDS];
+      std::lock_guard<std::mutex> lock(shard.lock_);
+      auto it = shard.tasks_.find(key);
+      if (it == shard.tasks_.end()) {
+        return false;
+      }
+      tid = it->second.tid_;
+      start_ts = it->second.start_time_;
+      end_ts = it->second.end_time_;
+      return true;
+    }
+
+    // Relations are logged with the task the arrow starts from first
+    static void LogRelation(uint64_t head, __itt_relation relation, uint64_t tail) {
+      OnIttRelationLoggingCallback callback = GetState().callback_;
+      if ((callback == nullptr) || (head == 0) || (tail == 0)) {
+        return;
+      }
+      switch (relation) {
+        case __itt_relation_is_dependent_on:
+          callback(tail, head, "is_dependent_on");
+          break;
+        case __itt_relation_is_sibling_of:
+          callback(tail, head, "is_sibling_of");
+          break;
+        case __itt_relation_is_parent_of:
+          callback(head, tail, "is_parent_of");
+          break;
+        case __itt_relation_is_continuation_of:
+          callback(tail, head, "is_continuation_of");
+          break;
+        case __itt_relation_is_child_of:
+          callback(tail, head, "is_child_of");
+          break;
+        case __itt_relation_is_continued_by:
+          callback(head, tail, "is_continued_by");
+          break;
+        case __itt_relation_is_predecessor_to:
+          callback(head, tail, "is_predecessor_to");
+          break;
+        default:
+          callback(tail, head, "is_related_to");
+          break;
+      }
+    }
+
+    static void SetCallback(OnIttRelationLoggingCallback callback) {
+      GetState().callback_ = callback;
+    }
+
+    static void PrepareFork(void) {
+      RegistryState& state = GetState();
+      for (int i = 0; i < ITT_TASK_REGISTRY_SHARDS; i++) {
+        state.shards_[i].lock_.lock();
+      }
+    }
+
+    static void ParentAfterFork(void) {
+      RegistryState& state = GetState();
+      for (int i = ITT_TASK_REGISTRY_SHARDS - 1; i >= 0; i--) {
+        state.shards_[i].lock_.unlock();
+      }
+    }
+
+    // Tasks of the parent are not in the trace of the child
+    static void ChildAfterFork(void) {
+      RegistryState& state = GetState();
+      for (int i = 0; i < ITT_TASK_REGISTRY_SHARDS; i++) {
+        new (&state.shards_[i].lock_) std::mutex();
+        state.shards_[i].tasks_.clear();
+      }
+    }
+
+  private:
+    struct alignas(64) RegistryShard {
+      std::mutex lock_;
+      std::unordered_map<uint64_t, IttTaskSpan> tasks_;
+    };
+
+    struct RegistryState {
+      RegistryShard shards_[ITT_TASK_REGISTRY_SHARDS];
+      OnIttRelationLoggingCallback callback_ = nullptr;
+    };
+
+    static RegistryState& GetState(void) {
+      static RegistryState *state = new RegistryState();
+      return *state;
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_RELATION_H_
@@ -0,0 +1,127 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_SYMBOL_H_
+#define PTI_TOOLS_UNITRACE_ITT_SYMBOL_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <cxxabi.h>
+#include <dlfcn.h>
+#endif /* _WIN32 */
+
+#include "unimemory.h"
+#include "unievent.h"
+#include "itt_track.h"
+#include "itt_module.h"
+#include "itt_utils.h"
+
+typedef void (*OnIttFunctionSliceLoggingCallback)(uint32_t tid, const char *domain, const void *fn, uint64_t start_ts, uint64_t end_ts, IttArgs* metadata_args);
+
+// Names of the functions of __itt_task_begin_fn(). Tasks are logged with the address of the function
+// only, and the address is resolved when the trace is written: against the modules of __itt_module_load*()
+// loaded when the task began first, and with dladdr() otherwise. Only functions in the dynamic symbol
+// table have names, others are named after their module and offset.
+class IttSymbols : public IttForkHandlers<IttSymbols> {
+  public:
+    // The name is cached and never freed
+    static const char *GetName(const void *fn, uint64_t ts) {
+      SymbolState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      std::string module = IttModules::GetName(fn, ts);
+      if (!module.empty()) {
+        auto it = state.module_names_.find(module);
+        if (it != state.module_names_.end()) {
+          return it->second->c_str();
+        }
+        std::string *name = new std::string(module);
+        UniMemory::ExitIfOutOfMemory((void *)name);
+        state.module_names_[module] = name;
+        return name->c_str();
+      }
+
+      auto it = state.names_.find(fn);
+      if (it != state.names_.end()) {
+        return it->second->c_str();
+      }
+      std::string *name = new std::string(Resolve(fn, state.demangle_));
+      UniMemory::ExitIfOutOfMemory((void *)name);
+      state.names_[fn] = name;
+      return name->c_str();
+    }
+
+    static void SetDemangle(bool demangle) {
+      GetState().demangle_ = demangle;
+    }
+
+    static void SetCallback(OnIttFunctionSliceLoggingCallback callback) {
+      GetState().callback_ = callback;
+    }
+
+    // Complete event of a task on a virtual track, or on the calling thread if track is nullptr
+    static void LogSlice(IttVirtualTrack *track, const char *domain, const void *fn, uint64_t start_ts, uint64_t end_ts, IttArgs* metadata_args) {
+      OnIttFunctionSliceLoggingCallback callback = GetState().callback_;
+      if (callback != nullptr) {
+        callback((track != nullptr) ? IttVirtualTracks::GetTid(track) : 0, domain, fn, start_ts, end_ts, metadata_args);
+      }
+    }
+
+  private:
+    friend class IttForkHandlers<IttSymbols>;
+
+    struct SymbolState {
+      std::mutex lock_;
+      std::unordered_map<const void *, std::string *> names_;
+      std::unordered_map<std::string, std::string *> module_names_;	// functions in modules of __itt_module_load*()
+      bool demangle_ = false;
+      OnIttFunctionSliceLoggingCallback callback_ = nullptr;
+    };
+
+    static SymbolState& GetState(void) {
+      static SymbolState *state = new SymbolState();
+      return *state;
+    }
+
+    static std::string Resolve(const void *fn, bool demangle) {
+      char str[64];
+#ifndef _WIN32
+      Dl_info info;
+      if (dladdr(fn, &info) != 0) {
+        if (info.dli_sname != nullptr) {
+          if (demangle) {
+            int status = 0;
+            char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            if (demangled != nullptr) {
+              std::string name = demangled;
+              free(demangled);
+              return name;
+            }
+          }
+          return info.dli_sname;
+        }
+        if (info.dli_fname != nullptr) {
+          std::string module = info.dli_fname;
+          size_t pos = module.find_last_of('/');
+          if (pos != std::string::npos) {
+            module = module.substr(pos + 1);
+          }
+          snprintf(str, sizeof(str), "+0x%llx", (unsigned long long)((const char *)fn - (const char *)info.dli_fbase));
+          return module + str;
+        }
+      }
+#endif /* _WIN32 */
+      snprintf(str, sizeof(str), "0x%llx", (unsigned long long)fn);
+      return str;
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_SYMBOL_H_
@@ -0,0 +1,296 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_SYNC_H_
+#define PTI_TOOLS_UNITRACE_ITT_SYNC_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.h"
+#include "unimemory.h"
+#include "itt_utils.h"
+
+#define ITT_SYNC_TABLE_SIZE	(0x1 << 18)	// must be a power of 2
+#define ITT_SYNC_UNNAMED	"UNNAMED_SYNC"
+
+// Wait and hold times of all sync objects of the same name
+struct IttSyncStats {
+  std::string name_;
+  std::atomic<uint64_t> acquisitions_{0};
+  std::atomic<uint64_t> wait_count_{0};
+  std::atomic<uint64_t> wait_time_{0};
+  std::atomic<uint64_t> max_wait_time_{0};
+  std::atomic<uint64_t> hold_count_{0};
+  std::atomic<uint64_t> hold_time_{0};
+  std::atomic<uint64_t> max_hold_time_{0};
+  std::atomic<uint64_t> cancels_{0};
+
+  static void UpdateMax(std::atomic<uint64_t>& max, uint64_t value) {
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while ((value > current) && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  void Reset(void) {
+    acquisitions_.store(0, std::memory_order_relaxed);
+    wait_count_.store(0, std::memory_order_relaxed);
+    wait_time_.store(0, std::memory_order_relaxed);
+    max_wait_time_.store(0, std::memory_order_relaxed);
+    hold_count_.store(0, std::memory_order_relaxed);
+    hold_time_.store(0, std::memory_order_relaxed);
+    max_hold_time_.store(0, std::memory_order_relaxed);
+    cancels_.store(0, std::memory_order_relaxed);
+  }
+};
+
+// Slot of the address table. The address of a slot never changes once it is claimed, so lookups need
+// no lock. The stats of a slot change when the object is created again or renamed.
+struct IttSyncSlot {
+  std::atomic<uintptr_t> addr_;
+  std::atomic<IttSyncStats *> stats_;
+};
+
+// Sync objects and their statistics.
+// Timestamps of prepare and acquired are kept by the calling thread until the matching acquired
+// and releasing. Objects used without __itt_sync_create() are counted as UNNAMED_SYNC. If
+// UNITRACE_IttSyncWaitThreshold is set, waits of at least that many microseconds are also
+// logged as slices.
+class IttSyncObjects : public IttForkHandlers<IttSyncObjects> {
+  public:
+    static void Create(void *addr, const char *objtype, const char *objname) {
+      std::string name = ((objtype != nullptr) && (objtype[0] != 0)) ? objtype : ITT_SYNC_UNNAMED;
+      if ((objname != nullptr) && (objname[0] != 0)) {
+        name = name + "::" + objname;
+      }
+      IttSyncSlot *slot = GetSlot(addr, true);
+      if (slot != nullptr) {
+        slot->stats_.store(GetStats(name), std::memory_order_release);
+      }
+    }
+
+    static void Rename(void *addr, const char *name) {
+      IttSyncSlot *slot = GetSlot(addr, true);
+      if (slot != nullptr) {
+        slot->stats_.store(GetStats(((name != nullptr) && (name[0] != 0)) ? name : ITT_SYNC_UNNAMED), std::memory_order_release);
+      }
+    }
+
+    static void Destroy(void *addr) {
+      IttSyncSlot *slot = GetSlot(addr, false);
+      if (slot != nullptr) {
+        slot->stats_.store(nullptr, std::memory_order_release);	// the slot is kept for the next object at the address
+      }
+      GetThreadTimes().erase(addr);
+    }
+
+    static void Prepare(void *addr, uint64_t ts) {
+      GetThreadTimes()[addr].prepare_time_ = ts;
+    }
+
+    static void Cancel(void *addr) {
+      auto& times = GetThreadTimes();
+      auto it = times.find(addr);
+      if ((it != times.end()) && (it->second.prepare_time_ != 0)) {
+        it->second.prepare_time_ = 0;
+        FindStats(addr)->cancels_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    // Returns the wait time, 0 if there was no prepare
+    static uint64_t Acquired(void *addr, uint64_t ts, uint64_t& wait_start, IttSyncStats *& stats) {
+      IttSyncTimes& times = GetThreadTimes()[addr];
+      stats = FindStats(addr);
+      stats->acquisitions_.fetch_add(1, std::memory_order_relaxed);
+      times.acquired_time_ = ts;
+
+      wait_start = times.prepare_time_;
+      if (wait_start == 0) {
+        return 0;
+      }
+      times.prepare_time_ = 0;
+      uint64_t wait = (ts > wait_start) ? (ts - wait_start) : 0;
+      stats->wait_count_.fetch_add(1, std::memory_order_relaxed);
+      stats->wait_time_.fetch_add(wait, std::memory_order_relaxed);
+      IttSyncStats::UpdateMax(stats->max_wait_time_, wait);
+      return wait;
+    }
+
+    static void Releasing(void *addr, uint64_t ts) {
+      auto& times = GetThreadTimes();
+      auto it = times.find(addr);
+      if ((it == times.end()) || (it->second.acquired_time_ == 0)) {
+        return;	// acquired by another thread
+      }
+      uint64_t hold = (ts > it->second.acquired_time_) ? (ts - it->second.acquired_time_) : 0;
+      if (it->second.prepare_time_ == 0) {
+        times.erase(it);
+      } else {
+        it->second.acquired_time_ = 0;
+      }
+      IttSyncStats *stats = FindStats(addr);
+      stats->hold_count_.fetch_add(1, std::memory_order_relaxed);
+      stats->hold_time_.fetch_add(hold, std::memory_order_relaxed);
+      IttSyncStats::UpdateMax(stats->max_hold_time_, hold);
+    }
+
+    // wait threshold in nanoseconds, 0 if waits are not logged
+    static uint64_t GetWaitThreshold(void) {
+      static uint64_t threshold = [] {
+        std::string value = utils::GetEnv("UNITRACE_IttSyncWaitThreshold");
+        double us = value.empty() ? 0.0 : std::atof(value.c_str());
+        return (us > 0.0) ? (uint64_t)(us * 1000.0) : (uint64_t)0;
+      }();
+      return threshold;
+    }
+
+    static std::string SummaryReport(void) {
+      const uint32_t kObjectLength = 10;
+      const uint32_t kCountLength = 12;
+      const uint32_t kTimeLength = 20;
+
+      SyncState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+
+      std::vector<IttSyncStats *> sorted;
+      size_t max_name_length = kObjectLength;
+      for (auto& value : state.stats_) {
+        if (value.second->acquisitions_.load(std::memory_order_relaxed) > 0) {
+          sorted.push_back(value.second);
+          max_name_length = std::max(max_name_length, value.first.size());
+        }
+      }
+      if (sorted.empty()) {
+        return "";
+      }
+      std::sort(sorted.begin(), sorted.end(), [](const IttSyncStats *l, const IttSyncStats *r) {
+        return l->wait_time_.load(std::memory_order_relaxed) > r->wait_time_.load(std::memory_order_relaxed);
+      });
+
+      std::string str;
+      str += IttReportHeader("ITT Sync Objects", rank_mpi);
+
+      str += IttAlign("Object", max_name_length) + ", " + IttAlign("Acquisitions", kCountLength) + ", " +
+        IttAlign("Waits", kCountLength) + ", " + IttAlign("Wait Time (ns)", kTimeLength) + ", " +
+        IttAlign("Max Wait (ns)", kTimeLength) + ", " + IttAlign("Hold Time (ns)", kTimeLength) + ", " +
+        IttAlign("Max Hold (ns)", kTimeLength) + ", " + IttAlign("Cancels", kCountLength) + "\n";
+
+      for (auto stats : sorted) {
+        str += IttAlign(stats->name_, max_name_length) + ", " +
+          IttAlign(std::to_string(stats->acquisitions_.load(std::memory_order_relaxed)), kCountLength) + ", " +
+          IttAlign(std::to_string(stats->wait_count_.load(std::memory_order_relaxed)), kCountLength) + ", " +
+          IttAlign(std::to_string(stats->wait_time_.load(std::memory_order_relaxed)), kTimeLength) + ", " +
+          IttAlign(std::to_string(stats->max_wait_time_.load(std::memory_order_relaxed)), kTimeLength) + ", " +
+          IttAlign(std::to_string(stats->hold_time_.load(std::memory_order_relaxed)), kTimeLength) + ", " +
+          IttAlign(std::to_string(stats->max_hold_time_.load(std::memory_order_relaxed)), kTimeLength) + ", " +
+          IttAlign(std::to_string(stats->cancels_.load(std::memory_order_relaxed)), kCountLength) + "\n";
+      }
+      return str;
+    }
+
+  private:
+    friend class IttForkHandlers<IttSyncObjects>;
+
+    // The child reports its own waits only. Objects keep their names.
+    static void ResetAfterFork(void) {
+      SyncState& state = GetState();
+      for (auto& value : state.stats_) {
+        value.second->Reset();
+      }
+    }
+
+    struct IttSyncTimes {
+      uint64_t prepare_time_ = 0;
+      uint64_t acquired_time_ = 0;
+    };
+
+    struct SyncState {
+      std::mutex lock_;	// protects stats_ only
+      std::map<std::string, IttSyncStats *> stats_;
+      IttSyncSlot *table_ = nullptr;
+      std::atomic<IttSyncStats *> unnamed_{nullptr};
+    };
+
+    static SyncState& GetState(void) {
+      static SyncState *state = [] {
+        SyncState *s = new SyncState();
+        // zeroed pages are not touched until slots are used
+        s->table_ = (IttSyncSlot *)calloc(ITT_SYNC_TABLE_SIZE, sizeof(IttSyncSlot));
+        UniMemory::ExitIfOutOfMemory((void *)s->table_);
+        return s;
+      }();
+      return *state;
+    }
+
+    static std::unordered_map<void *, IttSyncTimes>& GetThreadTimes(void) {
+      thread_local std::unordered_map<void *, IttSyncTimes> times;
+      return times;
+    }
+
+    static IttSyncStats *GetStats(const std::string& name) {
+      SyncState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      IttSyncStats *& stats = state.stats_[name];
+      if (stats == nullptr) {
+        stats = new IttSyncStats();
+        UniMemory::ExitIfOutOfMemory((void *)stats);
+        stats->name_ = name;
+      }
+      return stats;
+    }
+
+    // Open addressing with linear probing. Returns nullptr if the address is not found,
+    // or if it is not found and the table is full when create is true.
+    static IttSyncSlot *GetSlot(void *addr, bool create) {
+      SyncState& state = GetState();
+      uintptr_t key = (uintptr_t)addr;
+      if (key == 0) {
+        return nullptr;
+      }
+      uint64_t h = (uint64_t)key * 0x9E3779B97F4A7C15ULL;
+      size_t index = (size_t)(h >> 32) & (ITT_SYNC_TABLE_SIZE - 1);
+      for (size_t i = 0; i < ITT_SYNC_TABLE_SIZE; i++) {
+        IttSyncSlot *slot = &state.table_[(index + i) & (ITT_SYNC_TABLE_SIZE - 1)];
+        uintptr_t current = slot->addr_.load(std::memory_order_acquire);
+        if (current == key) {
+          return slot;
+        }
+        if (current == 0) {
+          if (!create) {
+            return nullptr;
+          }
+          if (slot->addr_.compare_exchange_strong(current, key, std::memory_order_acq_rel) || (current == key)) {
+            return slot;
+          }
+        }
+      }
+      return nullptr;
+    }
+
+    static IttSyncStats *FindStats(void *addr) {
+      IttSyncSlot *slot = GetSlot(addr, false);
+      IttSyncStats *stats = (slot != nullptr) ? slot->stats_.load(std::memory_order_acquire) : nullptr;
+      if (stats != nullptr) {
+        return stats;
+      }
+      SyncState& state = GetState();
+      stats = state.unnamed_.load(std::memory_order_acquire);
+      if (stats == nullptr) {	// let it race, the same stats are returned
+        stats = GetStats(ITT_SYNC_UNNAMED);
+        state.unnamed_.store(stats, std::memory_order_release);
+      }
+      return stats;
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_SYNC_H_
@@ -0,0 +1,189 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_TRACK_H_
+#define PTI_TOOLS_UNITRACE_ITT_TRACK_H_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "unimemory.h"
+#include "unievent.h"
+#include "itt_utils.h"
+
+#define ITT_TRACK_TID_BASE	0x40000000	// above any thread id, so virtual tracks never collide with threads
+
+typedef void (*OnIttTrackNameLoggingCallback)(uint32_t tid, const char *name, uint32_t sort_index);
+typedef void (*OnIttTrackSliceLoggingCallback)(uint32_t tid, const char *name, uint64_t start_ts, uint64_t end_ts, IttArgs* metadata_args);
+
+// A timeline that is not a thread, e.g. the frames of a domain or a track of __itt_track_create().
+// It is a thread with a synthetic id in the trace. Its name and sort index are logged with the first
+// event of the track in each process, and tracks are sorted after the threads in the order they are created.
+struct IttVirtualTrack {
+  std::string name_;
+  uint32_t tid_;
+  std::atomic<bool> named_{false};
+  IttVirtualTrack *next_ = nullptr;
+};
+
+class IttVirtualTracks : public IttForkHandlers<IttVirtualTracks> {
+  public:
+    // Tracks are never freed
+    static IttVirtualTrack *Create(const std::string& name) {
+      TrackState& state = GetState();
+      IttVirtualTrack *track = new IttVirtualTrack();
+      UniMemory::ExitIfOutOfMemory((void *)track);
+      track->name_ = name;
+      std::lock_guard<std::mutex> lock(state.lock_);
+      track->tid_ = ITT_TRACK_TID_BASE + state.num_tracks_++;
+      track->next_ = state.track_list_;
+      state.track_list_ = track;
+      return track;
+    }
+
+    // The track of the given name, created on first use
+    static IttVirtualTrack *Get(const std::string& name) {
+      TrackState& state = GetState();
+      {
+        std::lock_guard<std::mutex> lock(state.lock_);
+        auto it = state.named_tracks_.find(name);
+        if (it != state.named_tracks_.end()) {
+          return it->second;
+        }
+      }
+      IttVirtualTrack *track = Create(name);
+      std::lock_guard<std::mutex> lock(state.lock_);
+      auto it = state.named_tracks_.emplace(name, track).first;
+      return it->second;	// a track created by a racing thread is left unused
+    }
+
+    // Track groups and tracks of the same name are created once
+    static __itt_track_group *CreateGroup(__itt_string_handle *name, __itt_track_group_type type) {
+      TrackState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      for (__itt_track_group *group = state.group_list_; group != nullptr; group = group->next) {
+        if (group->name == name) {
+          return group;
+        }
+      }
+
+      __itt_track_group *group = (__itt_track_group *)malloc(sizeof(__itt_track_group));
+      UniMemory::ExitIfOutOfMemory((void *)group);
+      group->name = name;
+      group->track = nullptr;
+      group->tgtype = type;
+      group->extra1 = 0;
+      group->extra2 = nullptr;
+      group->next = state.group_list_;
+      state.group_list_ = group;
+      return group;
+    }
+
+    static __itt_track *CreateTrack(__itt_track_group *group, __itt_string_handle *name, __itt_track_type type) {
+      std::string track_name = ((name != nullptr) && (name->strA != nullptr)) ? name->strA : "";
+      if ((group != nullptr) && (group->name != nullptr) && (group->name->strA != nullptr)) {
+        track_name = std::string(group->name->strA) + "::" + track_name;
+      }
+      IttVirtualTrack *virtual_track = Get(track_name);
+
+      TrackState& state = GetState();
+      std::lock_guard<std::mutex> lock(state.lock_);
+      __itt_track **list = (group != nullptr) ? &group->track : &state.ungrouped_track_list_;
+      for (__itt_track *track = *list; track != nullptr; track = track->next) {
+        if (track->name == name) {
+          return track;
+        }
+      }
+
+      __itt_track *track = (__itt_track *)malloc(sizeof(__itt_track));
+      UniMemory::ExitIfOutOfMemory((void *)track);
+      track->name = name;
+      track->group = group;
+      track->ttype = type;
+      track->extra1 = 0;
+      track->extra2 = virtual_track;
+      track->next = *list;
+      *list = track;
+      return track;
+    }
+
+    // Events of the thread go to the track until it is set to nullptr. This is on the scheduling path
+    // of the application, so it only stores the track.
+    static void SetThreadTrack(__itt_track *track) {
+      thread_track_ = (track != nullptr) ? (IttVirtualTrack *)track->extra2 : nullptr;
+    }
+
+    static IttVirtualTrack *GetThreadTrack(void) {
+      return thread_track_;
+    }
+
+    static void SetCallbacks(OnIttTrackNameLoggingCallback name_callback, OnIttTrackSliceLoggingCallback slice_callback) {
+      TrackState& state = GetState();
+      state.name_callback_ = name_callback;
+      state.slice_callback_ = slice_callback;
+    }
+
+    static bool IsLoggingOn(void) {
+      return (GetState().slice_callback_ != nullptr);
+    }
+
+    // Thread id of the track in the trace, the track is named on first use
+    static uint32_t GetTid(IttVirtualTrack *track) {
+      Name(GetState(), track);
+      return track->tid_;
+    }
+
+    static void LogSlice(IttVirtualTrack *track, const char *name, uint64_t start_ts, uint64_t end_ts, IttArgs* metadata_args) {
+      TrackState& state = GetState();
+      if (state.slice_callback_ == nullptr) {
+        return;
+      }
+      Name(state, track);
+      state.slice_callback_(track->tid_, name, start_ts, end_ts, metadata_args);
+    }
+
+  private:
+    friend class IttForkHandlers<IttVirtualTracks>;
+
+    // Names are logged again in the trace of the child
+    static void ResetAfterFork(void) {
+      TrackState& state = GetState();
+      for (IttVirtualTrack *track = state.track_list_; track != nullptr; track = track->next_) {
+        track->named_.store(false, std::memory_order_relaxed);
+      }
+    }
+
+    struct TrackState {
+      std::mutex lock_;
+      uint32_t num_tracks_ = 0;
+      IttVirtualTrack *track_list_ = nullptr;
+      std::map<std::string, IttVirtualTrack *> named_tracks_;
+      __itt_track_group *group_list_ = nullptr;
+      __itt_track *ungrouped_track_list_ = nullptr;
+      OnIttTrackNameLoggingCallback name_callback_ = nullptr;
+      OnIttTrackSliceLoggingCallback slice_callback_ = nullptr;
+    };
+
+    inline static thread_local IttVirtualTrack *thread_track_ = nullptr;
+
+    static TrackState& GetState(void) {
+      static TrackState *state = new TrackState();
+      return *state;
+    }
+
+    static void Name(TrackState& state, IttVirtualTrack *track) {
+      if (track->named_.load(std::memory_order_acquire) || track->named_.exchange(true)) {
+        return;
+      }
+      if (state.name_callback_ != nullptr) {
+        state.name_callback_(track->tid_, track->name_.c_str(), track->tid_);
+      }
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_TRACK_H_
@@ -0,0 +1,54 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_ITT_UTILS_H_
+#define PTI_TOOLS_UNITRACE_ITT_UTILS_H_
+
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "utils.h"
+
+// Banner of a summary printed at exit, e.g. "ITT Frames"
+static inline std::string IttReportHeader(const std::string& title, const std::string& rank) {
+  std::string str;
+  str += "************************************************************\n";
+  str += "*  " + title + " | Process ID : " + std::to_string(utils::GetPid()) + " | Rank ID : " + rank + "\n";
+  str += "************************************************************\n";
+  return str;
+}
+
+// Column of a summary, right aligned
+static inline std::string IttAlign(const std::string& str, size_t width) {
+  return std::string((str.size() < width) ? (width - str.size()) : 0, ' ') + str;
+}
+
+// pthread_atfork() handlers of a subsystem whose state is guarded by one lock, GetState().lock_.
+// The child gets a new lock, then the subsystem resets what the child must not inherit in
+// ResetAfterFork(), if it has one.
+template <typename Subsystem>
+class IttForkHandlers {
+  public:
+    static void PrepareFork(void) {
+      Subsystem::GetState().lock_.lock();
+    }
+
+    static void ParentAfterFork(void) {
+      Subsystem::GetState().lock_.unlock();
+    }
+
+    static void ChildAfterFork(void) {
+      new (&Subsystem::GetState().lock_) std::mutex();
+      Subsystem::ResetAfterFork();
+    }
+
+  protected:
+    static void ResetAfterFork(void) {
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_ITT_UTILS_H_
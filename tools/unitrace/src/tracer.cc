@@ -7,6 +7,8 @@
 #include <csignal>
 #include <iostream>
 
+#include <pthread.h>
+
 #include "tracer.h"
 #include "unitimer.h"
 
@@ -215,6 +217,26 @@ void HandleAbnormalTermination(int sig) {
   }
 }
 
+// Without these a forked child (e.g. a data loader worker) inherits the parent's buffered events,
+// trace file and possibly a held lock
+static void PrepareFork(void) {
+  if (tracer != nullptr) {
+    tracer->PrepareFork();
+  }
+}
+
+static void ParentAfterFork(void) {
+  if (tracer != nullptr) {
+    tracer->ParentAfterFork();
+  }
+}
+
+static void ChildAfterFork(void) {
+  if (tracer != nullptr) {
+    tracer->ChildAfterFork();
+  }
+}
+
 void CONSTRUCTOR Init(void) {
   std::string unitrace_version = utils::GetEnv("UNITRACE_VERSION");
   if (unitrace_version.size() > 0) {
@@ -256,6 +278,7 @@ void CONSTRUCTOR Init(void) {
   if (!tracer) {
     UniTimer::StartUniTimer();
     tracer = UniTracer::Create(ReadArgs());
+    pthread_atfork(PrepareFork, ParentAfterFork, ChildAfterFork);
   }
   if (utils::GetEnv("UNITRACE_FollowChildProcess") == "0") {
     // restore LD_PRELOAD from UNITRACE_LD_PRELOAD_OLD to prevent the unitrace library
@@ -43,7 +43,7 @@ class UniTracer {
     UniTracer* tracer = new UniTracer(options);
     UniMemory::ExitIfOutOfMemory((void *)tracer);
 
-    if (tracer->CheckOption(TRACE_CHROME_ITT_LOGGING) || tracer->CheckOption(TRACE_CCL_SUMMARY_REPORT)) {
+    if (tracer->CheckOption(TRACE_CHROME_ITT_LOGGING) || tracer->CheckOption(TRACE_CCL_SUMMARY_REPORT) || tracer->CheckOption(TRACE_CHROME_MPI_LOGGING)) {
         itt_collector = IttCollector::Create(ChromeLogger::IttLoggingCallback);
         if (itt_collector) {
             if (tracer->CheckOption(TRACE_CCL_SUMMARY_REPORT)) {
@@ -51,6 +51,24 @@ class UniTracer {
             }
             if (tracer->CheckOption(TRACE_CHROME_ITT_LOGGING)) {
                 itt_collector->EnableChromeLogging();
+                itt_collector->SetMetadataCallback(ChromeLogger::IttMetadataLoggingCallback);
+                itt_collector->SetThreadNameCallback(ChromeLogger::IttThreadNameLoggingCallback);
+                IttCounterSampler::SetCallback(ChromeLogger::IttCounterLoggingCallback);
+                IttVirtualTracks::SetCallbacks(ChromeLogger::IttTrackNameLoggingCallback, ChromeLogger::IttTrackSliceLoggingCallback);
+                IttRegions::SetCallback(ChromeLogger::IttAsyncLoggingCallback);
+                IttOverlappedTasks::SetCallback(ChromeLogger::IttAsyncLoggingCallback);
+                IttTaskRegistry::SetCallback(ChromeLogger::IttRelationLoggingCallback);
+                itt_task_lookup_ = IttTaskRegistry::Lookup;
+                IttMarks::SetCallback(ChromeLogger::IttMarkLoggingCallback);
+                IttModules::SetCallback(ChromeLogger::IttMarkLoggingCallback);
+                IttSymbols::SetCallback(ChromeLogger::IttFunctionSliceLoggingCallback);
+                IttSymbols::SetDemangle(tracer->CheckOption(TRACE_DEMANGLE));
+                itt_symbol_lookup_ = IttSymbols::GetName;
+            }
+            if (tracer->CheckOption(TRACE_CHROME_MPI_LOGGING)) {
+                itt_collector->EnableMpiLogging();
+                itt_collector->SetMpiCallback(ChromeLogger::MpiLoggingCallback);
+                itt_collector->SetMpiInternalCallback(ChromeLogger::MpiInternalLoggingCallback);
             }
         }
     }
@@ -66,6 +84,10 @@ class UniTracer {
 
     Report();
 
+    // last counter values are logged before the trace is finalized
+    IttCounterSampler::Stop();
+    IttHistograms::Log();
+
     if (itt_collector != nullptr){
       // Print CCL summary before deleting the object
       // If CCL summary is not enbled summary string will be empty
@@ -73,6 +95,42 @@ class UniTracer {
       if (summary.size() > 0){
         logger_.Log(summary);
       }
+      std::string frame_summary = IttFrames::SummaryReport();
+      if (frame_summary.size() > 0) {
+        logger_.Log(frame_summary);
+      }
+      std::string region_summary = IttRegionTimes::SummaryReport("ITT Regions");
+      if (region_summary.size() > 0) {
+        logger_.Log(region_summary);
+      }
+      std::string overlapped_summary = IttOverlappedTaskTimes::SummaryReport("ITT Overlapped Tasks");
+      if (overlapped_summary.size() > 0) {
+        logger_.Log(overlapped_summary);
+      }
+      std::string histogram_summary = IttHistograms::SummaryReport();
+      if (histogram_summary.size() > 0) {
+        logger_.Log(histogram_summary);
+      }
+      std::string sync_summary = IttSyncObjects::SummaryReport();
+      if (sync_summary.size() > 0) {
+        logger_.Log(sync_summary);
+      }
+      std::string heap_summary = IttHeapFunctions::SummaryReport();
+      if (heap_summary.size() > 0) {
+        logger_.Log(heap_summary);
+      }
+      std::string mark_summary = IttMarks::SummaryReport();
+      if (mark_summary.size() > 0) {
+        logger_.Log(mark_summary);
+      }
+      std::string mpi_summary = IttMpiMessages::SummaryReport();
+      if (mpi_summary.size() > 0) {
+        logger_.Log(mpi_summary);
+      }
+      std::string model_summary = IttModelSites::SummaryReport();
+      if (model_summary.size() > 0) {
+        logger_.Log(model_summary);
+      }
       delete itt_collector;
     }
 
@@ -90,6 +148,84 @@ class UniTracer {
     return options_.CheckFlag(option);
   }
 
+  void PrepareFork() {
+    IttCounterSampler::PrepareFork();
+    IttClockDomains::PrepareFork();
+    IttFrames::PrepareFork();
+    IttRegionTimes::PrepareFork();
+    IttHistograms::PrepareFork();
+    IttSyncObjects::PrepareFork();
+    IttHeapFunctions::PrepareFork();
+    IttVirtualTracks::PrepareFork();
+    IttOverlappedTasks::PrepareFork();
+    IttOverlappedTaskTimes::PrepareFork();
+    IttMpiMessages::PrepareFork();
+    IttMarks::PrepareFork();
+    IttModelSites::PrepareFork();
+    if (itt_collector != nullptr) {
+      itt_collector->PrepareFork();
+    }
+    if (chrome_logger_ != nullptr) {
+      chrome_logger_->PrepareFork();
+    }
+    // task spans, function names and modules are looked up while the trace is written, under its lock
+    IttTaskRegistry::PrepareFork();
+    IttSymbols::PrepareFork();
+    IttModules::PrepareFork();
+    logger_.Flush();
+  }
+
+  void ParentAfterFork() {
+    IttModules::ParentAfterFork();
+    IttSymbols::ParentAfterFork();
+    IttTaskRegistry::ParentAfterFork();
+    if (chrome_logger_ != nullptr) {
+      chrome_logger_->ParentAfterFork();
+    }
+    if (itt_collector != nullptr) {
+      itt_collector->ParentAfterFork();
+    }
+    IttModelSites::ParentAfterFork();
+    IttMarks::ParentAfterFork();
+    IttMpiMessages::ParentAfterFork();
+    IttOverlappedTaskTimes::ParentAfterFork();
+    IttOverlappedTasks::ParentAfterFork();
+    IttVirtualTracks::ParentAfterFork();
+    IttHeapFunctions::ParentAfterFork();
+    IttSyncObjects::ParentAfterFork();
+    IttHistograms::ParentAfterFork();
+    IttRegionTimes::ParentAfterFork();
+    IttFrames::ParentAfterFork();
+    IttClockDomains::ParentAfterFork();
+    IttCounterSampler::ParentAfterFork();
+  }
+
+  void ChildAfterFork() {
+    start_time_ = utils::GetSystemTime();
+    IttModules::ChildAfterFork();
+    IttSymbols::ChildAfterFork();
+    IttTaskRegistry::ChildAfterFork();
+    if (chrome_logger_ != nullptr) {
+      chrome_logger_->ChildAfterFork(utils::GetEnv("UNITRACE_FollowChildProcess") != "0");
+    }
+    if (itt_collector != nullptr) {
+      itt_collector->ChildAfterFork();
+    }
+    IttModelSites::ChildAfterFork();
+    IttMarks::ChildAfterFork();
+    IttMpiMessages::ChildAfterFork();
+    IttOverlappedTaskTimes::ChildAfterFork();
+    IttOverlappedTasks::ChildAfterFork();
+    IttVirtualTracks::ChildAfterFork();
+    IttHeapFunctions::ChildAfterFork();
+    IttSyncObjects::ChildAfterFork();
+    IttHistograms::ChildAfterFork();
+    IttRegionTimes::ChildAfterFork();
+    IttFrames::ChildAfterFork();
+    IttClockDomains::ChildAfterFork();
+    IttCounterSampler::ChildAfterFork();
+  }
+
   UniTracer(const UniTracer& that) = delete;
   UniTracer& operator=(const UniTracer& that) = delete;
 
@@ -100,7 +236,7 @@ class UniTracer {
         CheckOption(TRACE_CONDITIONAL_COLLECTION)) {
 
     start_time_ = utils::GetSystemTime();
-    if (CheckOption(TRACE_CHROME_CALL_LOGGING) || CheckOption(TRACE_CHROME_KERNEL_LOGGING) || CheckOption(TRACE_CHROME_DEVICE_LOGGING) || CheckOption(TRACE_CHROME_SYCL_LOGGING) || CheckOption(TRACE_CHROME_ITT_LOGGING)) {
+    if (CheckOption(TRACE_CHROME_CALL_LOGGING) || CheckOption(TRACE_CHROME_KERNEL_LOGGING) || CheckOption(TRACE_CHROME_DEVICE_LOGGING) || CheckOption(TRACE_CHROME_SYCL_LOGGING) || CheckOption(TRACE_CHROME_ITT_LOGGING) || CheckOption(TRACE_CHROME_MPI_LOGGING)) {
       chrome_logger_ = ChromeLogger::Create(options, GetChromeTraceFileName().c_str());
     }
 
@@ -0,0 +1,184 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_UNICONTAINER_H
+#define PTI_TOOLS_UNITRACE_UNICONTAINER_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "unimemory.h"
+#include "unistage.h"
+
+#define CONTAINER_COPY_CHUNK_SIZE	(0x1 << 22)
+
+// Per-node container of trace files.
+// When UNITRACE_TraceContainer is set to 1, each process writes its trace to a private node-local
+// file and, when the trace is complete, appends it as one block to <hostname>.unitrace in the
+// output directory. Every block starts with a one-line header:
+//
+//   #UNITRACE file=<trace file name> pid=<pid> rank=<rank> size=<bytes>
+//
+// and an index line "<trace file name> <pid> <rank> <offset> <bytes>" is appended to
+// <hostname>.unitrace.idx, so tools can list or extract a single rank with one seek.
+// Appends from all processes on the node are serialized with flock() on the container.
+class UniContainer {
+  public:
+    static bool IsContainerEnabled(void) {
+      static bool enabled = (utils::GetEnv("UNITRACE_TraceContainer") == "1");
+      return enabled;
+    }
+
+    // Where the process writes its trace before it is appended to the container
+    static std::string GetPrivateFileName(const std::string& final_name) {
+      if (UniStaging::IsStagingEnabled()) {
+        return UniStaging::GetStagedFileName(final_name);
+      }
+
+      std::string dir = utils::GetEnv("TMPDIR");
+      if (dir.empty()) {
+        dir = "/tmp";
+      }
+      size_t pos = final_name.find_last_of('/');
+      return dir + '/' + ((pos == std::string::npos) ? final_name : final_name.substr(pos + 1));
+    }
+
+    static std::string GetContainerFileName(const std::string& final_name) {
+      char hname[256];
+      gethostname(hname, sizeof(hname));
+      hname[255] = 0;
+
+      size_t pos = final_name.find_last_of('/');
+      if (pos == std::string::npos) {
+        return std::string(hname) + ".unitrace";
+      }
+      return final_name.substr(0, pos + 1) + hname + ".unitrace";
+    }
+
+    // Append private_name as a block of the node container. The private file is removed on success.
+    static bool AppendFile(const std::string& private_name, const std::string& final_name) {
+      std::string container = GetContainerFileName(final_name);
+      std::string index = container + ".idx";
+
+      int in = open(private_name.c_str(), O_RDONLY);
+      if (in < 0) {
+        return false;
+      }
+      struct stat st;
+      if (fstat(in, &st) != 0) {
+        close(in);
+        return false;
+      }
+
+      int out = open(container.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if (out < 0) {
+        std::cerr << "[WARNING] Failed to open trace container " << container << ": " << strerror(errno) << std::endl;
+        close(in);
+        return false;
+      }
+      int idx = open(index.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if (idx < 0) {
+        std::cerr << "[WARNING] Failed to open trace container index " << index << ": " << strerror(errno) << std::endl;
+        close(out);
+        close(in);
+        return false;
+      }
+
+      std::string rank = (utils::GetEnv("PMI_RANK").empty()) ? utils::GetEnv("PMIX_RANK") : utils::GetEnv("PMI_RANK");
+      if (rank.empty()) {
+        rank = "-1";
+      }
+      size_t pos = final_name.find_last_of('/');
+      std::string name = (pos == std::string::npos) ? final_name : final_name.substr(pos + 1);
+      std::string pid = std::to_string(utils::GetPid());
+      std::string size = std::to_string(st.st_size);
+      std::string header = "#UNITRACE file=" + name + " pid=" + pid + " rank=" + rank + " size=" + size + "\n";
+
+      bool ok = false;
+      if (flock(out, LOCK_EX) == 0) {
+        off_t offset = lseek(out, 0, SEEK_END);
+        if ((offset >= 0) && WriteAll(out, header.c_str(), header.size())) {
+          off_t data_offset = offset + header.size();
+          if (CopyAll(in, out)) {
+            std::string entry = name + " " + pid + " " + rank + " " + std::to_string(data_offset) + " " + size + "\n";
+            ok = WriteAll(idx, entry.c_str(), entry.size());
+          }
+          if (!ok) {
+            // drop the partial block so that the container stays parseable
+            if (ftruncate(out, offset) != 0) {
+              std::cerr << "[WARNING] Trace container " << container << " may have a partial block" << std::endl;
+            }
+          }
+        }
+        flock(out, LOCK_UN);
+      }
+
+      close(idx);
+      close(out);
+      close(in);
+
+      if (ok) {
+        unlink(private_name.c_str());
+      } else {
+        std::cerr << "[WARNING] Failed to append " << private_name << " to trace container " << container << std::endl;
+      }
+      return ok;
+    }
+
+  private:
+    static bool WriteAll(int fd, const char *data, size_t size) {
+      size_t written = 0;
+      while (written < size) {
+        ssize_t n = write(fd, data + written, size - written);
+        if (n < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return false;
+        }
+        written += n;
+      }
+      return true;
+    }
+
+    static bool CopyAll(int in, int out) {
+      char *buffer = (char *)malloc(CONTAINER_COPY_CHUNK_SIZE);
+      UniMemory::ExitIfOutOfMemory((void *)buffer);
+
+      bool ok = true;
+      while (true) {
+        ssize_t nread = read(in, buffer, CONTAINER_COPY_CHUNK_SIZE);
+        if (nread == 0) {
+          break;
+        }
+        if (nread < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          ok = false;
+          break;
+        }
+        if (!WriteAll(out, buffer, nread)) {
+          ok = false;
+          break;
+        }
+      }
+      free(buffer);
+      return ok;
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_UNICONTAINER_H
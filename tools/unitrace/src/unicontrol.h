@@ -9,6 +9,7 @@
 #define PTI_TOOLS_UNITRACE_UNICONTROL_H
 
 #include "utils.h"
+#include <atomic>
 #include <iostream>
 #include <cstring>
 extern char **environ;
@@ -44,6 +45,25 @@ class UniController{
       }
       return true;
     }
+    // Ignored threads and the host scope of __itt_pause_scoped() are checked before the environment, so
+    // recording paths of an ignored thread or a paused scope return early. Unlike __itt_pause(), scoped
+    // pauses do not need --conditional-collection.
+    static bool IsHostCollectionEnabled(void) {
+      return !thread_ignored_ && host_enabled_.load(std::memory_order_relaxed) && IsCollectionEnabled();
+    }
+    static void IttPauseScoped(void) {
+      host_enabled_.store(false, std::memory_order_relaxed);
+    }
+    static void IttResumeScoped(void) {
+      host_enabled_.store(true, std::memory_order_relaxed);
+    }
+    // __itt_thread_ignore(). The thread is ignored until it exits.
+    static bool IsThreadIgnored(void) {
+      return thread_ignored_;
+    }
+    static void IttIgnoreThread(void) {
+      thread_ignored_ = true;
+    }
     static void IttPause(void) {
       itt_paused_ = true;
       utils::SetEnv("PTI_ENABLE_COLLECTION", "0");
@@ -55,6 +75,8 @@ class UniController{
   private:
     inline static bool conditional_collection_ = (utils::GetEnv("UNITRACE_ConditionalCollection") == "1") ? true : false;
     inline static bool itt_paused_ = false;
+    inline static std::atomic<bool> host_enabled_{true};
+    inline static thread_local bool thread_ignored_ = false;
 };
     
 #endif // PTI_TOOLS_UNITRACE_UNICONTROL_H
@@ -17,6 +17,14 @@ enum EVENT_TYPE {
   EVENT_FLOW_SINK,
   EVENT_COMPLETE,
   EVENT_MARK,
+  EVENT_COUNTER,
+  EVENT_THREAD_NAME,	// name of a thread or of a virtual track
+  EVENT_ASYNC_START,
+  EVENT_ASYNC_END,
+  EVENT_RELATION,	// flow between two ITT tasks, resolved when the event is written
+  EVENT_INSTANT_PROCESS,	// instant event of the process
+  EVENT_INSTANT_GLOBAL,	// instant event of all processes
+  EVENT_INSTANT_THREAD,	// instant event of a thread or of a virtual track
 };
 
 enum API_TYPE {
@@ -35,8 +43,15 @@ typedef struct MpiArgs_ {
   size_t dst_size;
   int64_t mpi_counter;
   bool is_tagged;
+  struct IttArgs_ *itt_args;	// arguments of __itt_metadata_add() of the task, nullptr if none
 } MpiArgs;
 
+typedef struct IttRelationArgs_ {
+  uint64_t from_task_;
+  uint64_t to_task_;
+  const char *relation_;	// static string
+} IttRelationArgs;
+
 typedef struct IttArgs_ {
   size_t count = 0;
   bool isIndirectData = false;
@@ -50,7 +65,10 @@ typedef struct HostEventRecord_ {
   uint64_t id_;
   uint64_t start_time_;
   uint64_t end_time_;
+  uint32_t tid_;	// thread or virtual track of the event, 0 for the thread of the buffer
   char *name_ = nullptr;
+  const void *fn_;	// if not nullptr, the event is named after this function in domain fn_domain_
+  const char *fn_domain_;
   API_TRACING_ID api_id_;
   EVENT_TYPE type_;
 
@@ -58,6 +76,7 @@ typedef struct HostEventRecord_ {
   union{
     MpiArgs mpi_args_;
     IttArgs itt_args_;
+    IttRelationArgs relation_args_;
   };
 } HostEventRecord;
 
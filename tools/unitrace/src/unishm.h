@@ -0,0 +1,732 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_UNISHM_H
+#define PTI_TOOLS_UNITRACE_UNISHM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "logger.h"
+#include "unimemory.h"
+#include "unistage.h"
+#include "unicontainer.h"
+
+// Shared-memory collection.
+// With UNITRACE_ShmCollector=1 the launcher forks, the child becomes the application and the
+// launcher stays behind as the collector. Instrumented processes register themselves in the
+// session control segment and publish flat event records into per-thread single-producer
+// single-consumer rings. The collector drains the rings, serializes the events and writes the
+// same per-process trace files the tool library would have written.
+
+#define SHM_SESSION_MAGIC	0x554e4954	// "UNIT"
+#define SHM_SESSION_VERSION	6
+#define SHM_MAX_PROCESSES	256
+#define SHM_DEFAULT_RINGS	4096		// UNITRACE_ShmRings
+#define SHM_MAX_RINGS		65536
+#define SHM_DEFAULT_RING_CAPACITY	2048	// UNITRACE_ShmRingRecords, records per ring, power of 2
+#define SHM_MIN_RING_CAPACITY	16
+#define SHM_MAX_RING_CAPACITY	(1 << 20)
+#define SHM_PAYLOAD_SIZE	984		// keeps a record at 1KB
+#define SHM_METADATA_SIZE	4096
+
+enum SHM_SLOT_STATE {
+  SHM_SLOT_FREE = 0,
+  SHM_SLOT_CLAIMED,	// taken by a producer, not ready yet. The pid of the producer is in the upper bits.
+  SHM_SLOT_ACTIVE,
+  SHM_SLOT_CLOSED,	// producer is gone, collector drains and frees the slot
+};
+
+#define SHM_SLOT_STATE_MASK	0xff
+#define SHM_SLOT_PID_SHIFT	8	// pids are less than 2^22 on Linux
+
+// End of a trace file, with the members of its "metadata" object if there are any.
+// Shared by the tool library and the collector.
+static inline std::string GetTraceFileFooter(const std::string& metadata) {
+  if (metadata.empty()) {
+    return "\n]\n}\n";
+  }
+  return "\n],\n\"metadata\": {" + metadata + "}\n}\n";
+}
+
+// A slot is claimed with the pid of the producer in the same word, so the collector can free the
+// slot if the producer dies before the slot is ready
+static inline uint32_t GetShmClaimedState(uint32_t pid) {
+  return SHM_SLOT_CLAIMED | (pid << SHM_SLOT_PID_SHIFT);
+}
+
+struct ShmEventRecord {
+  uint64_t id_;
+  uint64_t start_time_;
+  uint64_t end_time_;
+  uint32_t tid_;	// virtual track of the event, 0 for the thread of the ring
+  char phase_;	// Chrome event phase, e.g. 'X'
+  char scope_;	// scope of an instant event, 't', 'p' or 'g'
+  uint16_t continuations_;	// number of records that follow and carry the rest of the payload as raw bytes
+  uint32_t name_size_;	// 0 if the event has no name
+  uint32_t args_size_;	// stringified arguments without braces, 0 if none
+  char payload_[SHM_PAYLOAD_SIZE];	// name followed by arguments, not terminated
+};
+
+struct ShmProcess {
+  std::atomic<uint32_t> state_;
+  uint32_t pid_;
+  uint64_t epoch_start_time_;	// producer's UniTimer epoch offset in ns
+  uint64_t process_start_time_;	// in us since epoch
+  char trace_file_name_[1024];
+  char process_name_[256];
+  char rank_[32];
+  char host_[256];
+  char metadata_[SHM_METADATA_SIZE];	// members of the "metadata" object of the trace, valid once the process is closed
+};
+
+struct ShmRingSlot {
+  std::atomic<uint32_t> state_;
+  uint32_t process_;	// index into processes_
+  uint32_t pid_;
+  uint32_t tid_;
+};
+
+// Followed by num_rings_ ring slots
+struct ShmControl {
+  uint32_t magic_;
+  uint32_t version_;
+  uint32_t collector_pid_;
+  uint32_t num_rings_;
+  uint32_t ring_capacity_;	// records per ring, power of 2
+  ShmProcess processes_[SHM_MAX_PROCESSES];
+};
+
+// Followed by the records
+struct ShmRing {
+  alignas(64) std::atomic<uint64_t> head_;	// written by producer
+  alignas(64) std::atomic<uint64_t> tail_;	// written by collector
+};
+
+static inline size_t GetShmControlSize(uint32_t num_rings) {
+  return sizeof(ShmControl) + num_rings * sizeof(ShmRingSlot);
+}
+
+static inline ShmRingSlot *GetShmRingSlots(ShmControl *control) {
+  return (ShmRingSlot *)(control + 1);
+}
+
+static inline size_t GetShmRingSize(uint32_t capacity) {
+  return sizeof(ShmRing) + capacity * sizeof(ShmEventRecord);
+}
+
+static inline ShmEventRecord *GetShmRingRecords(ShmRing *ring) {
+  return (ShmEventRecord *)(ring + 1);
+}
+
+static inline std::string GetShmRingName(const std::string& session, uint32_t slot) {
+  return session + "." + std::to_string(slot);
+}
+
+static inline void *MapShm(const std::string& name, size_t size, bool create) {
+  int fd = create ? shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600) : shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return nullptr;
+  }
+  if (create && (ftruncate(fd, size) != 0)) {
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    if (create) {
+      shm_unlink(name.c_str());
+    }
+    return nullptr;
+  }
+  return addr;
+}
+
+static inline bool IsProcessAlive(uint32_t pid) {
+  return (kill(pid, 0) == 0) || (errno != ESRCH);
+}
+
+// Producer side of one ring. Only one thread publishes into a ring at a time.
+class ShmRingWriter {
+  public:
+    ShmRingWriter(ShmRing *ring, uint32_t capacity, ShmRingSlot *slot, uint32_t collector_pid)
+      : ring_(ring), capacity_(capacity), slot_(slot), collector_pid_(collector_pid) {}
+
+    ShmRingWriter(const ShmRingWriter& that) = delete;
+    ShmRingWriter& operator=(const ShmRingWriter& that) = delete;
+
+    ~ShmRingWriter() {
+      if (ring_ != nullptr) {
+        munmap(ring_, GetShmRingSize(capacity_));
+        slot_->state_.store(SHM_SLOT_CLOSED, std::memory_order_release);
+      }
+    }
+
+    // In a forked child: unmap the ring without closing it. The ring still belongs to the parent.
+    void Detach(void) {
+      if (ring_ != nullptr) {
+        munmap(ring_, GetShmRingSize(capacity_));
+        ring_ = nullptr;
+      }
+    }
+
+    // Copies the event, its name and its arguments into the ring. A payload that does not fit in
+    // the record goes on in the records that follow, which are committed together with it.
+    // Returns false if the collector has gone away.
+    bool Publish(const ShmEventRecord& header, const std::string& name, const std::string& args) {
+      const std::string *event_args = &args;
+      static const std::string truncated = "\"truncated\": 1";
+      uint64_t count = GetRecordCount(name.size() + args.size());
+      if (count > capacity_ / 2) {
+        event_args = &truncated;	// too large for the ring
+        count = GetRecordCount(name.size() + truncated.size());
+        if (count > capacity_ / 2) {
+          return true;	// drop the event
+        }
+      }
+      if (!WaitForRecords(count)) {
+        return false;
+      }
+
+      uint64_t head = ring_->head_.load(std::memory_order_relaxed);
+      ShmEventRecord *records = GetShmRingRecords(ring_);
+      ShmEventRecord *rec = &records[head & (capacity_ - 1)];
+      memcpy(rec, &header, offsetof(ShmEventRecord, payload_));
+      rec->continuations_ = (uint16_t)(count - 1);
+      rec->name_size_ = name.size();
+      rec->args_size_ = event_args->size();
+
+      // name and arguments are copied as one byte stream
+      const char *parts[2] = {name.data(), event_args->data()};
+      size_t sizes[2] = {name.size(), event_args->size()};
+      char *dst = rec->payload_;
+      size_t room = SHM_PAYLOAD_SIZE;
+      for (int i = 0; i < 2; i++) {
+        const char *src = parts[i];
+        size_t size = sizes[i];
+        while (size > 0) {
+          if (room == 0) {
+            dst = (char *)&records[(++head) & (capacity_ - 1)];
+            room = sizeof(ShmEventRecord);
+          }
+          size_t n = (size < room) ? size : room;
+          memcpy(dst, src, n);
+          dst += n;
+          src += n;
+          size -= n;
+          room -= n;
+        }
+      }
+
+      ring_->head_.store(ring_->head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+      return true;
+    }
+
+  private:
+    static uint64_t GetRecordCount(size_t payload_size) {
+      if (payload_size <= SHM_PAYLOAD_SIZE) {
+        return 1;
+      }
+      return 1 + (payload_size - SHM_PAYLOAD_SIZE + sizeof(ShmEventRecord) - 1) / sizeof(ShmEventRecord);
+    }
+
+    // Waits for the collector until count records are free. Returns false if the collector has gone away.
+    bool WaitForRecords(uint64_t count) {
+      uint64_t head = ring_->head_.load(std::memory_order_relaxed);
+      int spins = 0;
+      while (head - ring_->tail_.load(std::memory_order_acquire) + count > capacity_) {
+        if (collector_lost_) {
+          return false;
+        }
+        if (++spins % 1024 == 0) {
+          if (!IsProcessAlive(collector_pid_)) {
+            collector_lost_ = true;
+            std::cerr << "[WARNING] Trace collector " << collector_pid_ << " is gone, events are dropped" << std::endl;
+            return false;
+          }
+          usleep(100);
+        } else {
+          sched_yield();
+        }
+      }
+      return true;
+    }
+
+    ShmRing *ring_;
+    uint32_t capacity_;
+    ShmRingSlot *slot_;
+    uint32_t collector_pid_;
+    bool collector_lost_ = false;
+};
+
+// Tool library side of a session
+class ShmPublisher {
+  public:
+    static ShmPublisher *Create(const std::string& trace_file_name, const std::string& process_name,
+                                const std::string& rank, const std::string& host,
+                                uint64_t epoch_start_time, uint64_t process_start_time) {
+      std::string session = utils::GetEnv("UNITRACE_ShmSession");
+      if (session.empty()) {
+        return nullptr;
+      }
+      ShmControl *control = (ShmControl *)MapShm(session, sizeof(ShmControl), false);
+      if (control == nullptr) {
+        std::cerr << "[WARNING] Unable to attach to trace collector session " << session << std::endl;
+        return nullptr;
+      }
+      if ((control->magic_ != SHM_SESSION_MAGIC) || (control->version_ != SHM_SESSION_VERSION) || !IsProcessAlive(control->collector_pid_)) {
+        munmap(control, sizeof(ShmControl));
+        return nullptr;
+      }
+      // map the ring slots too now that their number is known
+      size_t control_size = GetShmControlSize(control->num_rings_);
+      munmap(control, sizeof(ShmControl));
+      control = (ShmControl *)MapShm(session, control_size, false);
+      if (control == nullptr) {
+        std::cerr << "[WARNING] Unable to attach to trace collector session " << session << std::endl;
+        return nullptr;
+      }
+
+      for (uint32_t i = 0; i < SHM_MAX_PROCESSES; i++) {
+        uint32_t expected = SHM_SLOT_FREE;
+        if (control->processes_[i].state_.compare_exchange_strong(expected, GetShmClaimedState(utils::GetPid()), std::memory_order_acq_rel)) {
+          ShmProcess& p = control->processes_[i];
+          p.pid_ = utils::GetPid();
+          p.epoch_start_time_ = epoch_start_time;
+          p.process_start_time_ = process_start_time;
+          if (trace_file_name[0] == '/') {
+            CopyString(p.trace_file_name_, sizeof(p.trace_file_name_), trace_file_name);
+          } else {
+            // the collector does not share the working directory of the process
+            char cwd[1024];
+            std::string dir = (getcwd(cwd, sizeof(cwd)) != nullptr) ? std::string(cwd) + '/' : std::string();
+            CopyString(p.trace_file_name_, sizeof(p.trace_file_name_), dir + trace_file_name);
+          }
+          CopyString(p.process_name_, sizeof(p.process_name_), process_name);
+          CopyString(p.rank_, sizeof(p.rank_), rank);
+          CopyString(p.host_, sizeof(p.host_), host);
+          p.metadata_[0] = 0;
+          p.state_.store(SHM_SLOT_ACTIVE, std::memory_order_release);
+
+          ShmPublisher *publisher = new ShmPublisher(session, control, control_size, i);
+          UniMemory::ExitIfOutOfMemory((void *)publisher);
+          return publisher;
+        }
+      }
+
+      std::cerr << "[WARNING] Too many processes in trace collector session " << session << std::endl;
+      munmap(control, control_size);
+      return nullptr;
+    }
+
+    ShmPublisher(const ShmPublisher& that) = delete;
+    ShmPublisher& operator=(const ShmPublisher& that) = delete;
+
+    // All rings must have been released. The collector finishes the trace file.
+    ~ShmPublisher() {
+      if (control_ != nullptr) {
+        control_->processes_[process_].state_.store(SHM_SLOT_CLOSED, std::memory_order_release);
+        munmap(control_, control_size_);
+      }
+    }
+
+    // Written just before the process is closed, so the collector never sees a partial copy
+    void SetMetadata(const std::string& metadata) {
+      if (control_ != nullptr) {
+        CopyString(control_->processes_[process_].metadata_, SHM_METADATA_SIZE, metadata);
+      }
+    }
+
+    // In a forked child: unmap the session without closing the parent's process slot
+    void Detach(void) {
+      if (control_ != nullptr) {
+        munmap(control_, control_size_);
+        control_ = nullptr;
+      }
+    }
+
+    ShmRingWriter *AcquireRing(uint32_t tid) {
+      ShmRingSlot *slots = GetShmRingSlots(control_);
+      uint32_t capacity = control_->ring_capacity_;
+      for (uint32_t i = 0; i < control_->num_rings_; i++) {
+        ShmRingSlot& slot = slots[i];
+        uint32_t expected = SHM_SLOT_FREE;
+        if (!slot.state_.compare_exchange_strong(expected, GetShmClaimedState(utils::GetPid()), std::memory_order_acq_rel)) {
+          continue;
+        }
+        ShmRing *ring = (ShmRing *)MapShm(GetShmRingName(session_, i), GetShmRingSize(capacity), true);
+        if (ring == nullptr) {
+          slot.state_.store(SHM_SLOT_FREE, std::memory_order_release);
+          return nullptr;
+        }
+        slot.process_ = process_;
+        slot.pid_ = utils::GetPid();
+        slot.tid_ = tid;
+        slot.state_.store(SHM_SLOT_ACTIVE, std::memory_order_release);
+
+        ShmRingWriter *writer = new ShmRingWriter(ring, capacity, &slot, control_->collector_pid_);
+        UniMemory::ExitIfOutOfMemory((void *)writer);
+        return writer;
+      }
+      return nullptr;
+    }
+
+  private:
+    ShmPublisher(const std::string& session, ShmControl *control, size_t control_size, uint32_t process)
+      : session_(session), control_(control), control_size_(control_size), process_(process) {}
+
+    static void CopyString(char *dst, size_t size, const std::string& src) {
+      strncpy(dst, src.c_str(), size - 1);
+      dst[size - 1] = 0;
+    }
+
+    std::string session_;
+    ShmControl *control_;
+    size_t control_size_;
+    uint32_t process_;
+};
+
+// Launcher side of a session
+class ShmCollector {
+  public:
+    static ShmCollector *Create(void) {
+      uint32_t num_rings = GetConfig("UNITRACE_ShmRings", SHM_DEFAULT_RINGS, 1, SHM_MAX_RINGS);
+      uint32_t capacity = GetConfig("UNITRACE_ShmRingRecords", SHM_DEFAULT_RING_CAPACITY, SHM_MIN_RING_CAPACITY, SHM_MAX_RING_CAPACITY);
+      while ((capacity & (capacity - 1)) != 0) {	// round up to a power of 2
+        capacity = (capacity | (capacity - 1)) + 1;
+      }
+
+      std::string session = "/unitrace." + std::to_string(utils::GetPid());
+      ShmControl *control = (ShmControl *)MapShm(session, GetShmControlSize(num_rings), true);
+      if (control == nullptr) {
+        std::cerr << "[WARNING] Unable to create trace collector session " << session << ": " << strerror(errno) << std::endl;
+        return nullptr;
+      }
+      control->magic_ = SHM_SESSION_MAGIC;
+      control->version_ = SHM_SESSION_VERSION;
+      control->collector_pid_ = utils::GetPid();
+      control->num_rings_ = num_rings;
+      control->ring_capacity_ = capacity;
+      utils::SetEnv("UNITRACE_ShmSession", session.c_str());
+
+      ShmCollector *collector = new ShmCollector(session, control);
+      UniMemory::ExitIfOutOfMemory((void *)collector);
+      return collector;
+    }
+
+    ShmCollector(const ShmCollector& that) = delete;
+    ShmCollector& operator=(const ShmCollector& that) = delete;
+
+    ~ShmCollector() {
+      ShmRingSlot *slots = GetShmRingSlots(control_);
+      for (uint32_t i = 0; i < control_->num_rings_; i++) {
+        if (rings_[i] != nullptr) {
+          munmap(rings_[i], GetShmRingSize(control_->ring_capacity_));
+        }
+        if (slots[i].state_.load(std::memory_order_acquire) != SHM_SLOT_FREE) {
+          shm_unlink(GetShmRingName(session_, i).c_str());
+        }
+      }
+      for (uint32_t i = 0; i < SHM_MAX_PROCESSES; i++) {
+        if (files_[i].logger_ != nullptr) {
+          FinishFile(i);
+        }
+      }
+      munmap(control_, GetShmControlSize(control_->num_rings_));
+      shm_unlink(session_.c_str());
+    }
+
+    // Collect until the application and every instrumented process it spawned are done.
+    // Returns the exit status of the application.
+    int Run(pid_t app) {
+      // the application gets the signals meant for it; the collector keeps draining
+      std::signal(SIGINT, SIG_IGN);
+      std::signal(SIGTERM, SIG_IGN);
+      std::signal(SIGHUP, SIG_IGN);
+
+      int status = 0;
+      bool app_running = true;
+      while (true) {
+        bool busy = Drain();
+
+        if (app_running && (waitpid(app, &status, WNOHANG) == app)) {
+          app_running = false;
+        }
+        if (!app_running && !busy && IsIdle()) {
+          break;
+        }
+        if (!busy) {
+          usleep(1000);
+        }
+      }
+
+      if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+      }
+      if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+      }
+      return 1;
+    }
+
+  private:
+    struct TraceFile {
+      Logger *logger_ = nullptr;
+      std::string staged_file_name_;
+      uint64_t num_events_ = 0;
+    };
+
+    ShmCollector(const std::string& session, ShmControl *control)
+      : session_(session), control_(control), rings_(control->num_rings_, nullptr), files_(SHM_MAX_PROCESSES) {}
+
+    // Positive number from the environment, or the default
+    static uint32_t GetConfig(const char *name, uint32_t value, uint32_t min, uint32_t max) {
+      std::string str = utils::GetEnv(name);
+      if (!str.empty()) {
+        long long n = std::atoll(str.c_str());
+        if (n > 0) {
+          value = (uint32_t)std::min((long long)max, std::max((long long)min, n));
+        }
+      }
+      return value;
+    }
+
+    bool Drain(void) {
+      bool busy = false;
+      ShmRingSlot *slots = GetShmRingSlots(control_);
+      uint32_t capacity = control_->ring_capacity_;
+      for (uint32_t i = 0; i < control_->num_rings_; i++) {
+        ShmRingSlot& slot = slots[i];
+        uint32_t state = slot.state_.load(std::memory_order_acquire);
+        if ((state & SHM_SLOT_STATE_MASK) == SHM_SLOT_CLAIMED) {
+          // a slot claimed by a producer that died before making it ready would stay claimed forever
+          if (!IsProcessAlive(state >> SHM_SLOT_PID_SHIFT)) {
+            // the ring may have been created already, and a new one is created exclusively
+            shm_unlink(GetShmRingName(session_, i).c_str());
+            slot.state_.compare_exchange_strong(state, SHM_SLOT_FREE, std::memory_order_acq_rel);
+          }
+          continue;
+        }
+        if ((state != SHM_SLOT_ACTIVE) && (state != SHM_SLOT_CLOSED)) {
+          continue;
+        }
+        if (rings_[i] == nullptr) {
+          rings_[i] = (ShmRing *)MapShm(GetShmRingName(session_, i), GetShmRingSize(capacity), false);
+          if (rings_[i] == nullptr) {
+            if ((state == SHM_SLOT_CLOSED) || !IsProcessAlive(slot.pid_)) {
+              shm_unlink(GetShmRingName(session_, i).c_str());
+              slot.state_.store(SHM_SLOT_FREE, std::memory_order_release);
+            }
+            continue;
+          }
+        }
+        ShmRing *ring = rings_[i];
+        uint64_t tail = ring->tail_.load(std::memory_order_relaxed);
+        uint64_t head = ring->head_.load(std::memory_order_acquire);
+        if (head != tail) {
+          busy = true;
+          for (uint64_t k = tail; k < head; ) {
+            const ShmEventRecord& rec = GetShmRingRecords(ring)[k & (capacity - 1)];
+            if (rec.continuations_ >= head - k) {
+              break;	// a producer commits an event together with its continuations
+            }
+            WriteEvent(slot, rec, ReadPayload(ring, capacity, k, rec));
+            k += 1 + rec.continuations_;
+          }
+          ring->tail_.store(head, std::memory_order_release);
+        } else if ((state == SHM_SLOT_CLOSED) || !IsProcessAlive(slot.pid_)) {
+          // the producer closed the ring (or died) before this empty check, so nothing is left
+          munmap(ring, GetShmRingSize(capacity));
+          rings_[i] = nullptr;
+          shm_unlink(GetShmRingName(session_, i).c_str());
+          slot.state_.store(SHM_SLOT_FREE, std::memory_order_release);
+        }
+      }
+
+      for (uint32_t i = 0; i < SHM_MAX_PROCESSES; i++) {
+        ShmProcess& p = control_->processes_[i];
+        uint32_t state = p.state_.load(std::memory_order_acquire);
+        if ((state & SHM_SLOT_STATE_MASK) == SHM_SLOT_CLAIMED) {
+          if (!IsProcessAlive(state >> SHM_SLOT_PID_SHIFT)) {
+            p.state_.compare_exchange_strong(state, SHM_SLOT_FREE, std::memory_order_acq_rel);
+          }
+          continue;
+        }
+        if (((state == SHM_SLOT_CLOSED) || ((state == SHM_SLOT_ACTIVE) && !IsProcessAlive(p.pid_))) && !HasRings(i)) {
+          FinishFile(i);
+          p.state_.store(SHM_SLOT_FREE, std::memory_order_release);
+        }
+      }
+      return busy;
+    }
+
+    bool HasRings(uint32_t process) {
+      ShmRingSlot *slots = GetShmRingSlots(control_);
+      for (uint32_t i = 0; i < control_->num_rings_; i++) {
+        const ShmRingSlot& slot = slots[i];
+        uint32_t state = slot.state_.load(std::memory_order_acquire);
+        if ((state != SHM_SLOT_FREE) && (slot.process_ == process) && (slot.pid_ == control_->processes_[process].pid_)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    bool IsIdle(void) {
+      for (uint32_t i = 0; i < SHM_MAX_PROCESSES; i++) {
+        uint32_t state = control_->processes_[i].state_.load(std::memory_order_acquire);
+        if ((state == SHM_SLOT_ACTIVE) || (state == SHM_SLOT_CLOSED)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    void OpenFile(uint32_t process) {
+      const ShmProcess& p = control_->processes_[process];
+      TraceFile& file = files_[process];
+      std::string final_name = p.trace_file_name_;
+      if (UniContainer::IsContainerEnabled()) {
+        file.staged_file_name_ = UniContainer::GetPrivateFileName(final_name);
+      } else if (UniStaging::IsStagingEnabled()) {
+        file.staged_file_name_ = UniStaging::GetStagedFileName(final_name);
+      } else {
+        file.staged_file_name_ = final_name;
+      }
+      file.logger_ = new Logger(file.staged_file_name_.c_str(), true, true);
+      UniMemory::ExitIfOutOfMemory((void *)(file.logger_));
+      file.num_events_ = 0;
+
+      std::string str = "{ \"traceEvents\":[\n";
+      str += "{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": " + std::to_string(p.pid_) +
+             ", \"ts\": " + std::to_string(p.process_start_time_) + ", \"args\": {\"name\": \"";
+      if (p.rank_[0] == 0) {
+        str += "HOST<" + std::string(p.host_) + ">\"}}";
+      } else {
+        str += "RANK " + std::string(p.rank_) + " HOST<" + std::string(p.host_) + ">\"}}";
+      }
+      file.logger_->Log(str);
+    }
+
+    void FinishFile(uint32_t process) {
+      const ShmProcess& p = control_->processes_[process];
+      TraceFile& file = files_[process];
+      std::string final_name = p.trace_file_name_;
+      if (file.logger_ == nullptr) {
+        std::cerr << "[INFO] No event of interest is logged for process " << p.pid_ << " (" << p.process_name_ << ")" << std::endl;
+        return;
+      }
+
+      // a process that died before closing has no metadata
+      bool closed = (p.state_.load(std::memory_order_acquire) == SHM_SLOT_CLOSED);
+      file.logger_->Log(GetTraceFileFooter(closed ? std::string(p.metadata_) : std::string()));
+      delete file.logger_;
+      file.logger_ = nullptr;
+      if (UniContainer::IsContainerEnabled() && UniContainer::AppendFile(file.staged_file_name_, final_name)) {
+        std::cerr << "[INFO] Timeline is stored in " << UniContainer::GetContainerFileName(final_name)
+                  << " as " << final_name.substr(final_name.find_last_of('/') + 1) << std::endl;
+      } else if (UniStaging::MigrateFile(file.staged_file_name_, final_name)) {
+        std::cerr << "[INFO] Timeline is stored in " << final_name << std::endl;
+      } else {
+        std::cerr << "[INFO] Timeline is stored in " << file.staged_file_name_ << std::endl;
+      }
+    }
+
+    // Name and arguments of the event at k, including the part in its continuation records
+    static std::string ReadPayload(ShmRing *ring, uint32_t capacity, uint64_t k, const ShmEventRecord& rec) {
+      size_t size = (size_t)rec.name_size_ + rec.args_size_;
+      std::string payload(rec.payload_, std::min(size, (size_t)SHM_PAYLOAD_SIZE));
+      for (uint32_t i = 1; i <= rec.continuations_ && payload.size() < size; i++) {
+        const char *chunk = (const char *)&GetShmRingRecords(ring)[(k + i) & (capacity - 1)];
+        payload.append(chunk, std::min(size - payload.size(), sizeof(ShmEventRecord)));
+      }
+      return payload;
+    }
+
+    void WriteEvent(const ShmRingSlot& slot, const ShmEventRecord& rec, const std::string& payload) {
+      if (files_[slot.process_].logger_ == nullptr) {
+        OpenFile(slot.process_);
+      }
+      TraceFile& file = files_[slot.process_];
+      file.logger_->Log(StringifyEvent(rec, payload.substr(0, rec.name_size_), payload.substr(std::min((size_t)rec.name_size_, payload.size())), slot.pid_, (rec.tid_ != 0) ? rec.tid_ : slot.tid_, control_->processes_[slot.process_].epoch_start_time_));
+      file.num_events_++;
+    }
+
+    // Same format as TraceBuffer::StringifyHostEvent()
+    static std::string StringifyEvent(const ShmEventRecord& rec, const std::string& name, const std::string& args, uint32_t pid, uint32_t tid, uint64_t epoch_start_time) {
+      std::string str = ",\n{";
+
+      str += "\"ph\": \"" + std::string(1, rec.phase_) + "\"";
+
+      str += ", \"tid\": " + std::to_string(tid);
+      str += ", \"pid\": " + std::to_string(pid);
+
+      if ((rec.phase_ == 's') && name.empty()) {
+        str += ", \"name\": \"dep\", \"cat\": \"Flow_H2D_" + std::to_string(rec.id_) + "\"";
+      } else if (rec.phase_ == 't') {
+        str += ", \"name\": \"dep\", \"cat\": \"Flow_D2H_" + std::to_string(rec.id_) + "\"";
+      } else {
+        if (!name.empty() && (name[0] == '\"')) {
+          str += ", \"name\": " + name;
+        } else if (!name.empty()) {
+          str += ", \"name\": \"" + name + "\"";
+        }
+        str += ", \"cat\": \"cpu_op\"";
+      }
+
+      if (rec.phase_ == 'f') {
+        str += ", \"bp\": \"e\"";
+      } else if (rec.phase_ == 'i') {
+        str += ", \"s\": \"" + std::string(1, rec.scope_) + "\"";
+      }
+
+      str += ", \"ts\": " + std::to_string(ToUs(epoch_start_time + rec.start_time_));
+      if (rec.phase_ == 'X') {
+        str += ", \"dur\": " + std::to_string(ToUs(rec.end_time_ - rec.start_time_));
+      }
+
+      if (!args.empty()) {
+        str += ", \"args\": {" + args + "}";
+      }
+      if (args.empty() || (rec.phase_ == 'b') || (rec.phase_ == 'e')) {
+        str += ", \"id\": " + std::to_string(rec.id_);
+      }
+
+      str += "}";
+      return str;
+    }
+
+    static double ToUs(uint64_t ns) {
+      return double(ns / 1000) + (double(ns % 1000) * 0.001);
+    }
+
+    std::string session_;
+    ShmControl *control_;
+    std::vector<ShmRing *> rings_;
+    std::vector<TraceFile> files_;
+};
+
+#endif // PTI_TOOLS_UNITRACE_UNISHM_H
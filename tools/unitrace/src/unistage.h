@@ -0,0 +1,210 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef PTI_TOOLS_UNITRACE_UNISTAGE_H
+#define PTI_TOOLS_UNITRACE_UNISTAGE_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "unimemory.h"
+
+#define STAGING_COPY_CONCURRENCY_DEFAULT	4
+#define STAGING_COPY_CHUNK_SIZE		(0x1 << 22)	// 4MB sequential copies
+
+// Node-local staging of output files.
+// When UNITRACE_TraceStagingDir is set, output files are first written to the staging
+// directory (e.g. /tmp or /dev/shm) and migrated to their final location when they are
+// closed. Migrations from all processes on the node share a small number of copy slots
+// (UNITRACE_TraceStagingCopyConcurrency, default 4), so the parallel file system sees a
+// few large sequential writers instead of every rank streaming at once.
+class UniStaging {
+  public:
+    // settings are read on first use as output files may be opened from library constructors
+    static bool IsStagingEnabled(void) {
+      static bool enabled = InitStaging();
+      return enabled;
+    }
+
+    static std::string GetStagedFileName(const std::string& final_name) {
+      const std::string& staging_dir = GetStagingDir();
+      size_t pos = final_name.find_last_of('/');
+      if (pos == std::string::npos) {
+        return staging_dir + '/' + final_name;
+      }
+      return staging_dir + '/' + final_name.substr(pos + 1);
+    }
+
+    static bool MigrateFile(const std::string& staged_name, const std::string& final_name) {
+      if (staged_name == final_name) {
+        return true;
+      }
+
+      // cheap path: staging and final directories are on the same file system
+      if (rename(staged_name.c_str(), final_name.c_str()) == 0) {
+        return true;
+      }
+      if (errno != EXDEV) {
+        std::cerr << "[WARNING] Failed to move " << staged_name << " to " << final_name << ": " << strerror(errno) << std::endl;
+        return false;
+      }
+
+      int slot = AcquireCopySlot();
+      bool copied = CopyFile(staged_name, final_name);
+      ReleaseCopySlot(slot);
+
+      if (!copied) {
+        std::cerr << "[WARNING] Failed to copy " << staged_name << " to " << final_name << ", staged file is kept" << std::endl;
+        return false;
+      }
+      unlink(staged_name.c_str());
+      return true;
+    }
+
+  private:
+    static bool InitStaging(void) {
+      const std::string& staging_dir = GetStagingDir();
+      if (staging_dir.empty()) {
+        return false;
+      }
+      if ((mkdir(staging_dir.c_str(), 0755) != 0) && (errno != EEXIST)) {
+        std::cerr << "[WARNING] Unable to create staging directory " << staging_dir << ", staging is disabled" << std::endl;
+        return false;
+      }
+      if (access(staging_dir.c_str(), W_OK) != 0) {
+        std::cerr << "[WARNING] Staging directory " << staging_dir << " is not writable, staging is disabled" << std::endl;
+        return false;
+      }
+      return true;
+    }
+
+    static int GetCopyConcurrency(void) {
+      static int concurrency = [] {
+        std::string value = utils::GetEnv("UNITRACE_TraceStagingCopyConcurrency");
+        int n = value.empty() ? 0 : std::atoi(value.c_str());
+        return (n > 0) ? n : STAGING_COPY_CONCURRENCY_DEFAULT;
+      }();
+      return concurrency;
+    }
+
+    // Copy slots are lock files in the staging directory. A process takes any free slot
+    // and waits on one only when all of them are in use.
+    static int AcquireCopySlot(void) {
+      if (!IsStagingEnabled()) {
+        return -1;
+      }
+      int concurrency = GetCopyConcurrency();
+      for (int i = 0; i < concurrency; i++) {
+        int fd = OpenCopySlot(i);
+        if (fd < 0) {
+          continue;
+        }
+        if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+          return fd;
+        }
+        close(fd);
+      }
+
+      int fd = OpenCopySlot(utils::GetPid() % concurrency);
+      if ((fd >= 0) && (flock(fd, LOCK_EX) != 0)) {
+        close(fd);
+        fd = -1;
+      }
+      return fd;	// -1 means no slot could be taken and the copy proceeds unthrottled
+    }
+
+    static void ReleaseCopySlot(int fd) {
+      if (fd >= 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+      }
+    }
+
+    static int OpenCopySlot(int slot) {
+      std::string slot_file = GetStagingDir() + "/.unitrace_copy_slot." + std::to_string(slot);
+      return open(slot_file.c_str(), O_RDWR | O_CREAT, 0666);
+    }
+
+    static bool CopyFile(const std::string& src, const std::string& dst) {
+      int in = open(src.c_str(), O_RDONLY);
+      if (in < 0) {
+        return false;
+      }
+
+      // write to a temporary file and rename it so a partially copied file never shows up under the final name
+      std::string tmp = dst + ".part";
+      int out = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (out < 0) {
+        close(in);
+        return false;
+      }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+      posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif /* POSIX_FADV_SEQUENTIAL */
+
+      char *buffer = (char *)malloc(STAGING_COPY_CHUNK_SIZE);
+      UniMemory::ExitIfOutOfMemory((void *)buffer);
+
+      bool ok = true;
+      while (ok) {
+        ssize_t nread = read(in, buffer, STAGING_COPY_CHUNK_SIZE);
+        if (nread == 0) {
+          break;
+        }
+        if (nread < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          ok = false;
+          break;
+        }
+        ssize_t written = 0;
+        while (written < nread) {
+          ssize_t n = write(out, buffer + written, nread - written);
+          if (n < 0) {
+            if (errno == EINTR) {
+              continue;
+            }
+            ok = false;
+            break;
+          }
+          written += n;
+        }
+      }
+
+      free(buffer);
+      close(in);
+      if (close(out) != 0) {
+        ok = false;
+      }
+
+      if (ok && (rename(tmp.c_str(), dst.c_str()) != 0)) {
+        ok = false;
+      }
+      if (!ok) {
+        unlink(tmp.c_str());
+      }
+      return ok;
+    }
+
+    static const std::string& GetStagingDir(void) {
+      static std::string dir = utils::GetEnv("UNITRACE_TraceStagingDir");
+      return dir;
+    }
+};
+
+#endif // PTI_TOOLS_UNITRACE_UNISTAGE_H
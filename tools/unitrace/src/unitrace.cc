@@ -8,6 +8,7 @@
 #include <vector>
 #include <cstring>
 #include "utils.h"
+#include "unishm.h"
 #include "version.h"
 #include "unitrace_commit_hash.h"
 
@@ -55,6 +56,26 @@ int main(int argc, char *argv[]) {
   }
   app_args.push_back(nullptr);
   std::cout << "[unitrace launcher] Launching: " << app_args[0] << std::endl;
+  if (utils::GetEnv("UNITRACE_ShmCollector") == "1") {
+    // stay behind as the collector and let the child become the application
+    ShmCollector *collector = ShmCollector::Create();
+    if (collector != nullptr) {
+      pid_t child = fork();
+      if (child == 0) {
+        execvp(app_args[0], app_args.data());
+        std::cerr << "[ERROR] Failed to launch target application: " << app_args[0] << std::endl;
+        _exit(1);
+      }
+      if (child > 0) {
+        int status = collector->Run(child);
+        delete collector;
+        return status;
+      }
+      std::cerr << "[WARNING] Failed to start trace collector, trace files are written by the application" << std::endl;
+      delete collector;
+      utils::SetEnv("UNITRACE_ShmSession", "");
+    }
+  }
   if (execvp(app_args[0], app_args.data())) {
     std::cerr << "[ERROR] Failed to launch target application: " << app_args[0] << std::endl;
   }
@@ -0,0 +1,44 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#include "ittnotify.h"
+
+// Tasks with explicit timestamps of a user clock that ticks in microseconds and of the host clock.
+// Their durations in the timeline, 5 ms and 2 ms, are checked by run_test.py.
+
+static unsigned long long GetMicroseconds(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void GetClockInfo(__itt_clock_info* clock_info, void* data) {
+  clock_info->clock_freq = 1000000;
+  clock_info->clock_base = GetMicroseconds();
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_clocks");
+
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_clock_domain* clock = __itt_clock_domain_create(GetClockInfo, nullptr);
+  unsigned long long us = GetMicroseconds();
+  __itt_task_begin_ex(domain, clock, us, __itt_null, __itt_null, __itt_string_handle_create("user_clock_task"));
+  __itt_task_end_ex(domain, clock, us + 5000);
+
+  // timestamps without a clock domain are host timestamps
+  __itt_clock_domain_reset();
+  __itt_timestamp ts = __itt_get_timestamp();
+  __itt_task_begin_ex(domain, nullptr, ts, __itt_null, __itt_null, __itt_string_handle_create("host_clock_task"));
+  __itt_task_end_ex(domain, nullptr, ts + 2000000);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
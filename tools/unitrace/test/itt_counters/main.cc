@@ -0,0 +1,59 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ittnotify.h"
+
+// Counters set by one thread and incremented by several. The final values are checked by run_test.py.
+
+static void Spin(uint32_t us) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+int main(int argc, char* argv[]) {
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_counter depth = __itt_counter_create_typed("queue_depth", "itt_counters", __itt_metadata_u64);
+  for (uint64_t i = 0; i < 8; ++i) {
+    __itt_counter_set_value(depth, &i);
+    Spin(500);
+  }
+
+  __itt_counter load = __itt_counter_create_typed("load", "itt_counters", __itt_metadata_double);
+  double value = 0.5;
+  __itt_counter_set_value(load, &value);
+
+  // 4 threads x 100 increments by 3 and 100 decrements by 1
+  __itt_counter credits = __itt_counter_create_typed("credits", "itt_counters", __itt_metadata_s64);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.push_back(std::thread([credits]() {
+      for (int k = 0; k < 100; ++k) {
+        __itt_counter_inc_delta(credits, 3);
+        __itt_counter_dec(credits);
+        Spin(20);
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  __itt_counter_destroy(depth);
+  __itt_counter_destroy(load);
+  __itt_counter_destroy(credits);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
@@ -0,0 +1,46 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <sched.h>
+
+#include "ittnotify.h"
+
+// Tasks named after the functions they run: oneCCL tasks of a function and of a name in the CCL
+// summary, and a task of a function that allocates memory in the heap summary. The summaries and
+// the names of the events are checked by run_test.py.
+
+int main(int argc, char* argv[]) {
+  __itt_domain* ccl = __itt_domain_create("oneCCL");
+  __itt_domain* domain = __itt_domain_create("itt_fn_tasks");
+  __itt_heap_function heap_malloc = __itt_heap_function_create("heap_malloc", "itt_fn_tasks");
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < 3; ++i) {
+    __itt_task_begin_fn(ccl, __itt_null, __itt_null, (void*)&sched_yield);
+    sched_yield();
+    __itt_task_end(ccl);
+  }
+  for (int i = 0; i < 2; ++i) {
+    __itt_task_begin(ccl, __itt_null, __itt_null, __itt_string_handle_create("allreduce"));
+    __itt_task_end(ccl);
+  }
+
+  __itt_task_begin_fn(domain, __itt_null, __itt_null, (void*)&malloc);
+  __itt_heap_allocate_begin(heap_malloc, 4096, 0);
+  void* p = malloc(4096);
+  __itt_heap_allocate_end(heap_malloc, &p, 4096, 0);
+  __itt_task_end(domain);
+  free(p);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
@@ -0,0 +1,64 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ittnotify.h"
+
+// Children created with fork(): one logs a task, one calls exec() and one exits without logging
+// anything. Only the parent and the first child write a trace, checked by run_test.py.
+
+static __itt_domain* domain = nullptr;
+
+static void Task(const char* name) {
+  __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create(name));
+  __itt_task_end(domain);
+}
+
+int main(int argc, char* argv[]) {
+  if ((argc > 1) && (strcmp(argv[1], "idle") == 0)) {
+    return 0;	// started with exec() by a child, logs nothing
+  }
+
+  domain = __itt_domain_create("itt_fork");
+
+  auto start = std::chrono::steady_clock::now();
+
+  Task("parent_before_fork");
+
+  pid_t children[3];
+  if ((children[0] = fork()) == 0) {
+    Task("child_task");
+    exit(0);
+  }
+  if ((children[1] = fork()) == 0) {
+    execl("/proc/self/exe", argv[0], "idle", (char *)nullptr);
+    _exit(1);
+  }
+  if ((children[2] = fork()) == 0) {
+    exit(0);
+  }
+  for (int i = 0; i < 3; ++i) {
+    int status = 0;
+    if ((waitpid(children[i], &status, 0) != children[i]) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+      std::cerr << "[ERROR] Child process " << i << " failed" << std::endl;
+      return 1;
+    }
+  }
+
+  Task("parent_after_fork");
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
@@ -0,0 +1,52 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+#include "ittnotify.h"
+
+// Frames that begin and end on the main thread, a frame that ends on another thread and
+// submitted frames: 7 frames of domain itt_frames, checked by run_test.py.
+
+static void Spin(uint32_t us) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_frames");
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < 4; ++i) {
+    __itt_frame_begin_v3(domain, nullptr);
+    Spin(200 * (i + 1));
+    __itt_frame_end_v3(domain, nullptr);
+  }
+
+  int frame;
+  __itt_id id = __itt_id_make(&frame, 1);
+  __itt_frame_begin_v3(domain, &id);
+  std::thread presenter([domain, &id]() {
+    Spin(300);
+    __itt_frame_end_v3(domain, &id);
+  });
+  presenter.join();
+
+  for (int i = 0; i < 2; ++i) {
+    __itt_timestamp begin = __itt_get_timestamp();
+    Spin(250);
+    __itt_frame_submit_v3(domain, nullptr, begin, __itt_get_timestamp());
+  }
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
@@ -0,0 +1,75 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "ittnotify.h"
+
+// An allocator reporting 9 allocations, 7 frees and 1 reallocation. One block is handed to
+// another thread again before its free ends. The calls, live and peak bytes in the summary and
+// the allocations of the task are checked by run_test.py.
+
+static const size_t kBlockSize = 1024 * 1024;
+
+static __itt_heap_function heap_malloc;
+
+static void* Allocate(size_t size) {
+  __itt_heap_allocate_begin(heap_malloc, size, 0);
+  void* p = malloc(size);
+  __itt_heap_allocate_end(heap_malloc, &p, size, 0);
+  return p;
+}
+
+static void Free(void* p) {
+  __itt_heap_free_begin(heap_malloc, p);
+  free(p);
+  __itt_heap_free_end(heap_malloc, p);
+}
+
+static void* Reallocate(void* p, size_t size) {
+  __itt_heap_reallocate_begin(heap_malloc, p, size, 0);
+  void* q = realloc(p, size);
+  __itt_heap_reallocate_end(heap_malloc, p, &q, size, 0);
+  return q;
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_heap");
+  heap_malloc = __itt_heap_function_create("heap_malloc", "itt_heap");
+
+  auto start = std::chrono::steady_clock::now();
+
+  void* blocks[8];
+  __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("alloc_task"));
+  for (int i = 0; i < 8; ++i) {
+    blocks[i] = Allocate(kBlockSize);
+  }
+  __itt_task_end(domain);
+
+  for (int i = 0; i < 6; ++i) {
+    Free(blocks[i]);
+  }
+  blocks[6] = Reallocate(blocks[6], 2 * kBlockSize);
+
+  // the block is reused by another thread after the free begins and before it ends, so it stays live
+  __itt_heap_free_begin(heap_malloc, blocks[7]);
+  std::thread t([&blocks]() {
+    __itt_heap_allocate_begin(heap_malloc, kBlockSize, 0);
+    __itt_heap_allocate_end(heap_malloc, &blocks[7], kBlockSize, 0);
+  });
+  t.join();
+  __itt_heap_free_end(heap_malloc, blocks[7]);
+
+  free(blocks[6]);
+  free(blocks[7]);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
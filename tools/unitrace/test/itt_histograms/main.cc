@@ -0,0 +1,53 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ittnotify.h"
+
+// Histograms with x and y values submitted by several threads, with y values only and with x values
+// only. The merged bins are checked by run_test.py.
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_histograms");
+
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_histogram* latency = __itt_histogram_create(domain, "latency", __itt_metadata_u32, __itt_metadata_u64);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 2; ++i) {
+    threads.push_back(std::thread([latency]() {
+      uint32_t x[3] = {1, 2, 4};
+      uint64_t y[3] = {10, 20, 40};
+      for (int k = 0; k < 2; ++k) {
+        __itt_histogram_submit(latency, 3, x, y);
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // x is the index of y
+  __itt_histogram* queue = __itt_histogram_create(domain, "queue", __itt_metadata_u32, __itt_metadata_s32);
+  int32_t first[3] = {1, -1, 2};
+  int32_t second[4] = {1, 1, 1, 1};
+  __itt_histogram_submit(queue, 3, nullptr, first);
+  __itt_histogram_submit(queue, 4, nullptr, second);
+
+  // each x is counted once
+  __itt_histogram* sizes = __itt_histogram_create(domain, "sizes", __itt_metadata_u64, __itt_metadata_u64);
+  uint64_t x[3] = {64, 64, 128};
+  __itt_histogram_submit(sizes, 3, x, nullptr);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
@@ -0,0 +1,45 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ittnotify.h"
+
+// Marks of two threads with parameters, one of them on a virtual track, a mark that is off and a
+// global mark. The counts in the summary and the instant events are checked by run_test.py.
+
+int main(int argc, char* argv[]) {
+  __itt_mark_type checkpoint = __itt_mark_create("checkpoint");
+  __itt_mark_type phase = __itt_mark_create("phase");
+  __itt_track* track = __itt_track_create(nullptr, __itt_string_handle_create("markers"), __itt_track_type_normal);
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 2; ++i) {
+    threads.push_back(std::thread([=]() {
+      if (i == 1) {
+        __itt_set_track(track);
+      }
+      __itt_mark(checkpoint, "s1");
+      __itt_mark(checkpoint, "long step 2");
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // marks that are off are logged but not counted
+  __itt_mark_off(checkpoint);
+  __itt_mark_global(phase, nullptr);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
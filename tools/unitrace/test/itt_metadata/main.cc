@@ -0,0 +1,52 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+#include "ittnotify.h"
+
+// Metadata of the global, track and task scopes, and of a task with __itt_metadata_add() of every
+// numeric type. The metadata object of the trace, the metadata event of the virtual track and the
+// arguments of the task are checked by run_test.py.
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_metadata");
+  __itt_track* track = __itt_track_create(nullptr, __itt_string_handle_create("workers"), __itt_track_type_normal);
+
+  auto start = std::chrono::steady_clock::now();
+
+  uint64_t runs[] = {1, 2};
+  __itt_metadata_str_add_with_scope(domain, __itt_scope_global, __itt_string_handle_create("build"), "release", 0);
+  __itt_metadata_add_with_scope(domain, __itt_scope_global, __itt_string_handle_create("runs"), __itt_metadata_u64, 1, &runs[0]);
+  // the last value of a key wins
+  __itt_metadata_add_with_scope(domain, __itt_scope_global, __itt_string_handle_create("runs"), __itt_metadata_u64, 2, runs);
+
+  std::thread worker([&]() {
+    int32_t device = 3;
+    __itt_set_track(track);
+    __itt_metadata_add_with_scope(domain, __itt_scope_track, __itt_string_handle_create("device"), __itt_metadata_s32, 1, &device);
+    // marker scope is ignored
+    __itt_metadata_add_with_scope(domain, __itt_scope_marker, __itt_string_handle_create("ignored"), __itt_metadata_s32, 1, &device);
+  });
+  worker.join();
+
+  uint16_t lanes = 16;
+  float scale = 0.5f;
+  double ratio = 0.25;
+  __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("compute"));
+  __itt_metadata_add(domain, __itt_null, __itt_string_handle_create("lanes"), __itt_metadata_u16, 1, &lanes);
+  __itt_metadata_add(domain, __itt_null, __itt_string_handle_create("scale"), __itt_metadata_float, 1, &scale);
+  __itt_metadata_add(domain, __itt_null, __itt_string_handle_create("ratio"), __itt_metadata_double, 1, &ratio);
+  __itt_metadata_str_add_with_scope(domain, __itt_scope_task, __itt_string_handle_create("mode"), "fast", 0);
+  __itt_task_end(domain);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
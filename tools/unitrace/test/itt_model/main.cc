@@ -0,0 +1,56 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <iostream>
+
+#include "ittnotify.h"
+
+// Serial sites annotated for parallelization: a site of independent tasks, a site of iteration tasks and
+// a site whose tasks mostly run in the critical section of one lock. The tasks and the speedups projected
+// on 4 threads in the summary are checked by run_test.py.
+
+static void Spin(int ms) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+int main(int argc, char* argv[]) {
+  static int lock;
+
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_model_site_beginA("independent");
+  for (int i = 0; i < 4; ++i) {
+    __itt_model_task_beginA("work");
+    Spin(5);
+    __itt_model_task_end_2();
+  }
+  __itt_model_site_end_2();
+
+  __itt_model_site_beginA("iterations");
+  for (int i = 0; i < 4; ++i) {
+    __itt_model_iteration_taskA("iteration");
+    Spin(5);
+  }
+  __itt_model_site_end_2();
+
+  __itt_model_site_beginA("locked");
+  for (int i = 0; i < 4; ++i) {
+    __itt_model_task_beginA("update");
+    Spin(1);
+    __itt_model_lock_acquire(&lock);
+    Spin(4);
+    __itt_model_lock_release(&lock);
+    __itt_model_task_end_2();
+  }
+  __itt_model_site_end_2();
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
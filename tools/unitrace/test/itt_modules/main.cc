@@ -0,0 +1,47 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "ittnotify.h"
+
+// Tasks of functions in the code ranges of modules reported with __itt_module_load(): a range that is
+// unloaded and reused by a smaller module, and a module loaded by an ignored thread, whose load is not
+// logged but still names the tasks. The names of the tasks and the module events are checked by
+// run_test.py.
+
+static char image[4096];
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_modules");
+
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_module_load(image, image + sizeof(image), "libbig.so");
+  __itt_task_begin_fn(domain, __itt_null, __itt_null, image + 2048);
+  __itt_task_end(domain);
+  __itt_module_unload(image);
+
+  __itt_module_load(image + 16, image + 32, "libsmall.so");
+  __itt_task_begin_fn(domain, __itt_null, __itt_null, image + 24);
+  __itt_task_end(domain);
+  __itt_task_begin_fn(domain, __itt_null, __itt_null, image + 2048);
+  __itt_task_end(domain);
+
+  std::thread ignored([]() {
+    __itt_thread_ignore();
+    __itt_module_load(image + 64, image + 128, "libignored.so");
+  });
+  ignored.join();
+  __itt_task_begin_fn(domain, __itt_null, __itt_null, image + 100);
+  __itt_task_end(domain);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
@@ -0,0 +1,66 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+#include <dlfcn.h>
+#include <sched.h>
+
+#include "ittnotify.h"
+
+// MPI tasks ended the way an MPI library ends them: 2 sends to rank 1 and a receive from rank 2
+// with an argument of __itt_metadata_add(), and 2 progress engine polls named after a function.
+// The communication matrix, the progress summary and the arguments of the events are checked by
+// run_test.py.
+
+typedef void (*EndExInfo)(const __itt_domain* domain, size_t src_size, int src_location, int src_tag,
+                          size_t dst_size, int dst_location, int dst_tag);
+typedef void (*EndCallbackInfo)(const __itt_domain* domain, int64_t mpi_counter, size_t src_size, size_t dst_size);
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_mpi");
+
+  // the MPI task ends are not in the ITT API, they are looked up in the collector
+  const char* collector = getenv("INTEL_LIBITTNOTIFY64");
+  void* handle = (collector != nullptr) ? dlopen(collector, RTLD_LAZY | RTLD_NOLOAD) : nullptr;
+  if (handle == nullptr) {
+    std::cerr << "The ITT collector is not loaded" << std::endl;
+    return 1;
+  }
+  EndExInfo end_ex_info = (EndExInfo)dlsym(handle, "__itt_task_end_internal_ex_info");
+  EndCallbackInfo end_callback_info = (EndCallbackInfo)dlsym(handle, "__itt_task_end_internal_callback_info");
+  if ((end_ex_info == nullptr) || (end_callback_info == nullptr)) {
+    std::cerr << "The ITT collector does not trace MPI tasks" << std::endl;
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_string_handle* send = __itt_string_handle_create("MPI_Send");
+  __itt_string_handle* comm = __itt_string_handle_create("comm");
+  uint64_t world = 42;
+  for (int i = 0; i < 2; ++i) {
+    __itt_task_begin(domain, __itt_null, __itt_null, send);
+    __itt_metadata_add(domain, __itt_null, comm, __itt_metadata_u64, 1, &world);
+    end_ex_info(domain, 0, -1, 0, 4096, 1, 7);
+  }
+  __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("MPI_Recv"));
+  end_ex_info(domain, 1024, 2, 3, 0, -1, 0);
+
+  // the progress engine yields while it polls
+  int64_t polls[2] = {5, 3};
+  for (int i = 0; i < 2; ++i) {
+    __itt_task_begin_fn(domain, __itt_null, __itt_null, (void*)&sched_yield);
+    end_callback_info(domain, polls[i], 100, 0);
+  }
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
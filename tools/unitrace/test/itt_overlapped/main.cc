@@ -0,0 +1,65 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ittnotify.h"
+
+// Overlapped tasks begun by one group of threads and ended by another, in a different order:
+// 32 "request" tasks, checked by run_test.py.
+
+#define NUM_THREADS 4
+#define TASKS_PER_THREAD 8
+
+static void Spin(uint32_t us) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_overlapped");
+  __itt_string_handle* request = __itt_string_handle_create("request");
+  static int requests[NUM_THREADS * TASKS_PER_THREAD];
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> senders;
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    senders.push_back(std::thread([domain, request, i]() {
+      for (int k = 0; k < TASKS_PER_THREAD; ++k) {
+        __itt_task_begin_overlapped(domain, __itt_id_make(&requests[i * TASKS_PER_THREAD + k], 0), __itt_null, request);
+        Spin(50);
+      }
+    }));
+  }
+  for (auto& t : senders) {
+    t.join();
+  }
+
+  // requests of thread i complete on thread i + 1, last one first
+  std::vector<std::thread> receivers;
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    receivers.push_back(std::thread([domain, i]() {
+      int sender = (i + 1) % NUM_THREADS;
+      for (int k = TASKS_PER_THREAD - 1; k >= 0; --k) {
+        __itt_task_end_overlapped(domain, __itt_id_make(&requests[sender * TASKS_PER_THREAD + k], 0));
+        Spin(50);
+      }
+    }));
+  }
+  for (auto& t : receivers) {
+    t.join();
+  }
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
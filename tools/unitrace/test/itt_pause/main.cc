@@ -0,0 +1,48 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <iostream>
+
+#include "ittnotify.h"
+
+// Tasks while the host scope, the offload scope and all scopes of the collection are paused with
+// __itt_pause_scoped(), and while __itt_pause() has no effect without --conditional-collection. The
+// tasks that are collected are checked by run_test.py.
+
+static void Task(__itt_domain* domain, const char* name) {
+  __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create(name));
+  __itt_task_end(domain);
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_pause");
+
+  auto start = std::chrono::steady_clock::now();
+
+  Task(domain, "collected");
+
+  __itt_pause_scoped(__itt_collection_scope_host);
+  Task(domain, "host_paused");
+  __itt_resume_scoped(__itt_collection_scope_host);
+
+  // ITT events are host events
+  __itt_pause_scoped(__itt_collection_scope_offload);
+  Task(domain, "offload_paused");
+  __itt_resume_scoped(__itt_collection_scope_offload);
+
+  __itt_pause_scoped(__itt_collection_scope_all);
+  Task(domain, "all_paused");
+  __itt_resume_scoped(__itt_collection_scope_all);
+
+  __itt_pause();
+  Task(domain, "itt_paused");
+  __itt_resume();
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
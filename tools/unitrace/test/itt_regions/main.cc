@@ -0,0 +1,58 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+#include "ittnotify.h"
+
+// Regions without an id, regions with ids that end in the order they began and a region of
+// another thread with the same id: 3 "step" and 3 "stage" regions, checked by run_test.py.
+
+static void Spin(uint32_t us) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_regions");
+  __itt_string_handle* step = __itt_string_handle_create("step");
+  __itt_string_handle* stage = __itt_string_handle_create("stage");
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < 3; ++i) {
+    __itt_region_begin(domain, __itt_null, __itt_null, step);
+    Spin(200);
+    __itt_region_end(domain, __itt_null);
+  }
+
+  int stages[2];
+  __itt_id first = __itt_id_make(&stages[0], 0);
+  __itt_id second = __itt_id_make(&stages[1], 0);
+  __itt_region_begin(domain, first, __itt_null, stage);
+  Spin(100);
+  __itt_region_begin(domain, second, __itt_null, stage);
+  Spin(100);
+  __itt_region_end(domain, first);
+  Spin(100);
+  __itt_region_end(domain, second);
+
+  // regions are matched per thread
+  std::thread worker([domain, stage, first]() {
+    __itt_region_begin(domain, first, __itt_null, stage);
+    Spin(200);
+    __itt_region_end(domain, first);
+  });
+  worker.join();
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
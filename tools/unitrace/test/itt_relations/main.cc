@@ -0,0 +1,62 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "ittnotify.h"
+
+// A task depending on a task of another thread and a task that is the parent of a task of another
+// thread. The flow arrows between the tasks are checked by run_test.py.
+
+static void Spin(int ms) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_relations");
+  static int tasks;
+
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_id produce = __itt_id_make(&tasks, 1);
+  __itt_id consume = __itt_id_make(&tasks, 2);
+  // the relation may be added before the tasks begin
+  __itt_relation_add(domain, consume, __itt_relation_is_dependent_on, produce);
+
+  std::thread producer([&]() {
+    __itt_task_begin(domain, produce, __itt_null, __itt_string_handle_create("produce"));
+    Spin(2);
+    __itt_task_end(domain);
+  });
+  producer.join();
+
+  std::thread consumer([&]() {
+    __itt_task_begin(domain, consume, __itt_null, __itt_string_handle_create("consume"));
+    Spin(2);
+    __itt_task_end(domain);
+  });
+  consumer.join();
+
+  __itt_id child = __itt_id_make(&tasks, 3);
+  __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("parent"));
+  __itt_relation_add_to_current(domain, __itt_relation_is_parent_of, child);
+  std::thread worker([&]() {
+    __itt_task_begin(domain, child, __itt_null, __itt_string_handle_create("child"));
+    Spin(2);
+    __itt_task_end(domain);
+  });
+  worker.join();
+  Spin(1);
+  __itt_task_end(domain);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
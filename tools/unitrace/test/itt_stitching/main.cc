@@ -0,0 +1,52 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "ittnotify.h"
+
+// A task spawns a continuation that runs on another thread in a callee of its caller. The top-level
+// task of the callee is a child of the spawning task, a task nested in it and a task begun after the
+// callee is left are not. The flow arrow between the tasks is checked by run_test.py.
+
+static void Spin(int ms) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_stitching");
+
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("spawn"));
+  __itt_caller caller = __itt_stack_caller_create();
+  Spin(1);
+  __itt_task_end(domain);
+
+  std::thread worker([&]() {
+    __itt_stack_callee_enter(caller);
+    __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("continuation"));
+    __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("nested"));
+    Spin(1);
+    __itt_task_end(domain);
+    __itt_task_end(domain);
+    __itt_stack_callee_leave(caller);
+
+    __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("after"));
+    Spin(1);
+    __itt_task_end(domain);
+  });
+  worker.join();
+  __itt_stack_caller_destroy(caller);
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
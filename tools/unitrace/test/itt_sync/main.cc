@@ -0,0 +1,60 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ittnotify.h"
+
+// A named mutex acquired 100 times by 4 threads and an unnamed object acquired 3 times and
+// cancelled once. Their acquisitions and cancels in the summary are checked by run_test.py.
+
+static std::mutex queue_lock;
+static int queue_length = 0;
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_sync");
+
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("contention"));
+  __itt_sync_create(&queue_lock, "std::mutex", "queue", 0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.push_back(std::thread([]() {
+      for (int k = 0; k < 25; ++k) {
+        __itt_sync_prepare(&queue_lock);
+        queue_lock.lock();
+        __itt_sync_acquired(&queue_lock);
+        ++queue_length;
+        __itt_sync_releasing(&queue_lock);
+        queue_lock.unlock();
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  __itt_sync_destroy(&queue_lock);
+  __itt_task_end(domain);
+
+  // objects used without __itt_sync_create() are counted as UNNAMED_SYNC
+  int flag = 0;
+  __itt_sync_prepare(&flag);
+  __itt_sync_cancel(&flag);
+  for (int k = 0; k < 3; ++k) {
+    __itt_fsync_prepare(&flag);
+    __itt_fsync_acquired(&flag);
+    __itt_fsync_releasing(&flag);
+  }
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return (queue_length == 100) ? 0 : 1;
+}
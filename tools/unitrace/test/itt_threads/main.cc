@@ -0,0 +1,59 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "ittnotify.h"
+
+// A named thread, a thread that is renamed, and an ignored thread whose domain is used by another
+// thread. The thread names and the tasks that are collected are checked by run_test.py.
+
+static void Task(__itt_domain* domain, const char* name) {
+  __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create(name));
+  __itt_task_end(domain);
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_threads");
+  __itt_domain* polling = nullptr;
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::thread worker([&]() {
+    // the same name is logged once
+    __itt_thread_set_name("metadata_worker");
+    __itt_thread_set_name("metadata_worker");
+    Task(domain, "work");
+  });
+  worker.join();
+
+  std::thread renamed([&]() {
+    __itt_thread_set_name("loader");
+    Task(domain, "load");
+    __itt_thread_set_name("decoder");
+    Task(domain, "decode");
+  });
+  renamed.join();
+
+  std::thread ignored([&]() {
+    __itt_thread_ignore();
+    __itt_thread_set_name("progress");
+    polling = __itt_domain_create("progress");
+    for (int i = 0; i < 100; ++i) {
+      Task(domain, "poll");
+    }
+  });
+  ignored.join();
+
+  // objects created by the ignored thread are still used
+  Task(polling, "progress");
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
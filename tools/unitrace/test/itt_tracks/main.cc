@@ -0,0 +1,61 @@
+//==============================================================
+// Copyright (C) Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "ittnotify.h"
+
+// Tasks of two threads redirected to the same virtual track, one of them following a task of the
+// main thread. The tracks of the tasks and the flow arrow to the virtual track are checked by
+// run_test.py.
+
+static void Spin(int ms) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+int main(int argc, char* argv[]) {
+  __itt_domain* domain = __itt_domain_create("itt_tracks");
+  static int tasks;
+
+  auto start = std::chrono::steady_clock::now();
+
+  __itt_track_group* group = __itt_track_group_create(__itt_string_handle_create("gpu_queues"), __itt_track_group_type_normal);
+  __itt_track* queue = __itt_track_create(group, __itt_string_handle_create("queue0"), __itt_track_type_normal);
+
+  __itt_id host = __itt_id_make(&tasks, 1);
+  __itt_id kernel = __itt_id_make(&tasks, 2);
+  __itt_task_begin(domain, host, __itt_null, __itt_string_handle_create("host"));
+  __itt_relation_add(domain, host, __itt_relation_is_predecessor_to, kernel);
+  Spin(1);
+  __itt_task_end(domain);
+
+  std::thread submitter([&]() {
+    __itt_set_track(queue);
+    __itt_task_begin(domain, kernel, __itt_null, __itt_string_handle_create("kernel"));
+    Spin(2);
+    __itt_task_end(domain);
+    __itt_set_track(nullptr);
+    __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("after"));
+    __itt_task_end(domain);
+  });
+  submitter.join();
+
+  std::thread copier([&]() {
+    __itt_set_track(queue);
+    __itt_task_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("copy"));
+    Spin(2);
+    __itt_task_end(domain);
+  });
+  copier.join();
+
+  std::chrono::duration<float> time = std::chrono::steady_clock::now() - start;
+  std::cout << "Total execution time: " << time.count() << " sec" << std::endl;
+  return 0;
+}
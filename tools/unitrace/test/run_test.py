@@ -8,8 +8,292 @@ import sys
 import subprocess
 import os
 import platform
+import shutil
+import json
+import glob
+import re
 import unidiff
 
+def last_counter_values(events):
+    values = {}
+    for event in events:
+        if event.get("ph") == "C":
+            values[event["name"]] = event["args"]["value"]
+    return values
+
+def check_counters(events, output):
+    values = last_counter_values(events)
+    expected = {"itt_counters::queue_depth": 7, "itt_counters::load": 0.5, "itt_counters::credits": 800}
+    return [f"Last value of counter {name} is {values.get(name)}, not {value}" for name, value in expected.items() if values.get(name) != value]
+
+def check_fork(events, output):
+    pids = {}
+    for event in events:
+        if event.get("ph") == "X":
+            pids.setdefault(event["name"], []).append(event["pid"])
+    parent = pids.get("itt_fork::parent_before_fork", [])
+    child = pids.get("itt_fork::child_task", [])
+    if (len(parent) != 1) or (len(child) != 1):
+        return [f"Tasks before the fork or in the child are logged {len(parent)} and {len(child)} times, not once"]
+    if (parent == child) or (pids.get("itt_fork::parent_after_fork") != parent):
+        return ["Tasks of the parent and of the child are not in their own processes"]
+    return []
+
+def get_track_tids(events):
+    # tid of each thread or virtual track by its name
+    return {event["args"]["name"]: event["tid"] for event in events if (event.get("ph") == "M") and (event.get("name") == "thread_name")}
+
+def check_frames(events, output):
+    tid = get_track_tids(events).get("Frames itt_frames")
+    frames = [event for event in events if (event.get("ph") == "X") and (event.get("name") == "itt_frames")]
+    errors = []
+    if (len(frames) != 7) or any(event["tid"] != tid for event in frames):
+        errors.append(f"{len(frames)} frames are found, not 7 on the frame track of the domain")
+    return errors + check_summary_count(output, "itt_frames", 7)
+
+def check_async_events(events, name, count):
+    # every instance is a begin and an end with an id of its own
+    begins = {event["id"]: event["ts"] for event in events if (event.get("ph") == "b") and (event.get("name") == name)}
+    ends = {event["id"]: event["ts"] for event in events if (event.get("ph") == "e") and (event.get("name") == name)}
+    if (len(begins) != count) or (begins.keys() != ends.keys()) or any(ends[id] < ts for id, ts in begins.items()):
+        return [f"{len(begins)} begins and {len(ends)} ends of {name} are found, not {count} pairs"]
+    return []
+
+def check_summary_count(output, name, count):
+    if not re.search(rf"^ *{re.escape(name)}, +{count},", output, re.M):
+        return [f"{name} is not counted {count} times in the summary"]
+    return []
+
+def check_regions(events, output):
+    errors = []
+    for name in ["itt_regions::step", "itt_regions::stage"]:
+        errors += check_async_events(events, name, 3)
+        errors += check_summary_count(output, name, 3)
+    return errors
+
+def check_overlapped_tasks(events, output):
+    name = "itt_overlapped::request"
+    errors = check_async_events(events, name, 32) + check_summary_count(output, name, 32)
+    begins = {event["id"]: event["tid"] for event in events if (event.get("ph") == "b") and (event.get("name") == name)}
+    if any((event.get("ph") == "e") and (event.get("name") == name) and (begins.get(event["id"]) == event["tid"]) for event in events):
+        errors.append(f"Tasks of {name} do not end on the threads that end them")
+    return errors
+
+def check_clocks(events, output):
+    tasks = {event["name"]: event for event in events if event.get("ph") == "X"}
+    errors = []
+    for name, duration in [("itt_clocks::user_clock_task", 5000), ("itt_clocks::host_clock_task", 2000)]:
+        if (name not in tasks) or (abs(tasks[name]["dur"] - duration) > 1):
+            errors.append(f"Task {name} does not take {duration} us")
+    if (len(errors) == 0) and (abs(tasks["itt_clocks::user_clock_task"]["ts"] - tasks["itt_clocks::host_clock_task"]["ts"]) > 1000000):
+        errors.append("Tasks of the user clock and of the host clock are more than a second apart")
+    return errors
+
+def check_histograms(events, output):
+    tid = get_track_tids(events).get("Histograms")
+    bins = {event["name"]: event.get("args") for event in events if (event.get("ph") == "X") and (event["tid"] == tid)}
+    expected = {"itt_histograms::latency": {"x": [1, 2, 4], "y": [40, 80, 160]},
+                "itt_histograms::queue": {"x": [0, 2, 3], "y": [2, 3, 1]},
+                "itt_histograms::sizes": {"x": [64, 128], "y": [2, 1]}}
+    return [f"Bins of histogram {name} are {bins.get(name)}, not {value}" for name, value in expected.items() if bins.get(name) != value]
+
+def check_sync(events, output):
+    errors = check_summary_count(output, "std::mutex::queue", 100)
+    if not re.search(r"^ *UNNAMED_SYNC, +3,.*, +1$", output, re.M):
+        errors.append("UNNAMED_SYNC is not acquired 3 times and cancelled once in the summary")
+    return errors
+
+def check_heap(events, output):
+    errors = []
+    mb = 1024 * 1024
+    row = re.search(r"^ *itt_heap::heap_malloc, +(\d+), +(\d+), +(\d+), +(\d+), +(\d+), +(\d+)$", output, re.M)
+    if row is None:
+        return ["itt_heap::heap_malloc is not in the summary"]
+    allocations, frees, reallocations, size, live, peak = [int(value) for value in row.groups()]
+    if (allocations, frees, reallocations, size) != (9, 7, 1, 11 * mb):
+        errors.append(f"Calls of itt_heap::heap_malloc are {row.group(0).strip()}")
+    # all blocks are sampled and stand for their own size only
+    if abs(live - 3 * mb) > mb // 100:
+        errors.append(f"Live bytes of itt_heap::heap_malloc are {live}, not {3 * mb}")
+    if abs(peak - 8 * mb) > mb // 100:
+        errors.append(f"Peak bytes of itt_heap::heap_malloc are {peak}, not {8 * mb}")
+    args = [event.get("args", {}) for event in events if (event.get("ph") == "X") and (event["name"] == "itt_heap::alloc_task")]
+    if (len(args) != 1) or (args[0].get("heap_allocations") != [8]) or (args[0].get("heap_bytes") != [8 * mb]):
+        errors.append(f"Allocations of task itt_heap::alloc_task are {args}")
+    return errors
+
+def check_flow(events, name, source, sink):
+    tasks = {event["name"]: event for event in events if event.get("ph") == "X"}
+    starts = [event for event in events if (event.get("ph") == "s") and (event["name"] == name)]
+    finishes = [event for event in events if (event.get("ph") == "f") and (event["name"] == name)]
+    if (len(starts) != 1) or (len(finishes) != 1) or (starts[0]["id"] != finishes[0]["id"]):
+        return [f"Flow {name} is not logged once"]
+    if (source not in tasks) or (sink not in tasks):
+        return [f"Tasks {source} and {sink} are not logged"]
+    errors = []
+    s, f = starts[0], finishes[0]
+    if (s["tid"] != tasks[source]["tid"]) or not (tasks[source]["ts"] - 1 <= s["ts"] <= tasks[source]["ts"] + tasks[source]["dur"] + 1):
+        errors.append(f"Flow {name} does not start from {source}")
+    if (f["tid"] != tasks[sink]["tid"]) or (abs(f["ts"] - tasks[sink]["ts"]) > 1):
+        errors.append(f"Flow {name} does not end where {sink} begins")
+    return errors
+
+def check_relations(events, output):
+    return check_flow(events, "is_dependent_on", "itt_relations::produce", "itt_relations::consume") + \
+        check_flow(events, "is_parent_of", "itt_relations::parent", "itt_relations::child")
+
+def check_tracks(events, output):
+    errors = []
+    tid = get_track_tids(events).get("gpu_queues::queue0")
+    tasks = {event["name"]: event["tid"] for event in events if event.get("ph") == "X"}
+    for name in ["itt_tracks::kernel", "itt_tracks::copy"]:
+        if tasks.get(name) != tid:
+            errors.append(f"Task {name} is not on track gpu_queues::queue0")
+    if tasks.get("itt_tracks::after") in [None, tid]:
+        errors.append("Task itt_tracks::after is not on its thread")
+    return errors + check_flow(events, "is_predecessor_to", "itt_tracks::host", "itt_tracks::kernel")
+
+def check_mpi(events, output):
+    errors = []
+    # peer rank, sent messages and bytes, received messages and bytes
+    for row in ["1, +2, +8192, +0, +0", "2, +0, +0, +1, +1024"]:
+        if not re.search(rf"^ *{row}$", output, re.M):
+            errors.append(f"Messages of peer rank {row.split(',')[0]} are not in the summary")
+    # calls, iterations, iterations per call, max iterations, bytes, bytes per call
+    # the function may be resolved to an alias of the C library, e.g. __sched_yield
+    if not re.search(r"^ *itt_mpi::\w*sched_yield, +2, +8, +4, +5, +200, +100$", output, re.M):
+        errors.append("Progress of itt_mpi::sched_yield is not in the summary")
+    sends = [event.get("args", {}) for event in events if (event.get("ph") == "X") and (event["name"] == "itt_mpi::MPI_Send")]
+    if (len(sends) != 2) or any((args.get("dst_rank"), args.get("dst_tag"), args.get("comm")) != (1, 7, [42]) for args in sends):
+        errors.append(f"Arguments of itt_mpi::MPI_Send are {sends}")
+    polls = [event.get("args", {}).get("mpi_counter") for event in events if (event.get("ph") == "X") and re.match(r"itt_mpi::\w*sched_yield$", event["name"])]
+    if sorted(polls) != [3, 5]:
+        errors.append(f"Progress of itt_mpi::sched_yield is {polls}")
+    return errors
+
+def check_marks(events, output):
+    errors = check_summary_count(output, "checkpoint", 4) + check_summary_count(output, "phase", 1)
+    tid = get_track_tids(events).get("markers")
+    marks = [event for event in events if event.get("ph") == "i"]
+    checkpoints = [event for event in marks if event["name"] == "checkpoint"]
+    if sorted(event.get("args", {}).get("parameter", [""])[0] for event in checkpoints) != ["long step 2", "long step 2", "s1", "s1"]:
+        errors.append(f"Parameters of checkpoint marks are {[event.get('args') for event in checkpoints]}")
+    if len([event for event in checkpoints if event["tid"] == tid]) != 2:
+        errors.append("Marks of the thread on track markers are not on the track")
+    if [event["s"] for event in marks if event["name"] == "checkpoint (off)"] != ["p"]:
+        errors.append("Mark checkpoint (off) is not logged once")
+    if [event["s"] for event in marks if event["name"] == "phase"] != ["g"]:
+        errors.append("Global mark phase is not logged once")
+    return errors
+
+def check_fn_tasks(events, output):
+    errors = []
+    # functions may be resolved to aliases of the C library, e.g. __sched_yield
+    if not re.search(r"^ *oneCCL::\w*sched_yield, +3,", output, re.M):
+        errors.append("Tasks of oneCCL::sched_yield are not counted 3 times in the CCL summary")
+    errors += check_summary_count(output, "oneCCL::allreduce", 2)
+    if not re.search(r"^ *itt_fn_tasks::\w*malloc, +1, +4096$", output, re.M):
+        errors.append("Allocations of tasks of itt_fn_tasks::malloc are not in the heap summary")
+    tasks = [event["name"] for event in events if (event.get("ph") == "X") and re.match(r"oneCCL::\w*sched_yield$", event["name"])]
+    if len(tasks) != 3:
+        errors.append(f"Tasks of oneCCL::sched_yield are logged {len(tasks)} times")
+    return errors
+
+def check_modules(events, output):
+    errors = []
+    tasks = sorted(event["name"] for event in events if (event.get("ph") == "X") and event["name"].startswith("itt_modules::"))
+    for name in ["itt_modules::libbig.so+0x800", "itt_modules::libignored.so+0x24", "itt_modules::libsmall.so+0x8"]:
+        if name not in tasks:
+            errors.append(f"Task {name} is not logged")
+    # the range of libbig.so is unloaded when its function runs again
+    if len([name for name in tasks if "libbig.so" in name]) != 1:
+        errors.append(f"Tasks after libbig.so is unloaded are named {tasks}")
+    tid = get_track_tids(events).get("Modules")
+    modules = [(event["name"], event.get("args", {}).get("path", [""])[0]) for event in sorted(events, key=lambda event: event.get("ts", 0)) if (event.get("ph") == "i") and (event["tid"] == tid)]
+    if modules != [("Module Load", "libbig.so"), ("Module Unload", "libbig.so"), ("Module Load", "libsmall.so")]:
+        errors.append(f"Module events on track Modules are {modules}")
+    return errors
+
+def check_stitching(events, output):
+    # only the top-level task of the callee is a child of the task of the caller
+    return check_flow(events, "is_child_of", "itt_stitching::spawn", "itt_stitching::continuation")
+
+def check_model(events, output):
+    errors = []
+    # site, instances, site time, tasks, task time, mean task, max task, lock time, speedup on 4 threads
+    sites = {}
+    for line in output.splitlines():
+        fields = [field.strip() for field in line.split(",")]
+        if (len(fields) == 9) and (fields[0] in ["independent", "iterations", "locked"]):
+            sites[fields[0]] = fields
+    for name, low, high in [("independent", 3.0, 4.01), ("iterations", 3.0, 4.01), ("locked", 1.0, 1.6)]:
+        if name not in sites:
+            errors.append(f"Site {name} is not in the summary")
+            continue
+        if (sites[name][1] != "1") or (sites[name][3] != "4"):
+            errors.append(f"Site {name} has {sites[name][1]} instances and {sites[name][3]} tasks")
+        if not (low <= float(sites[name][8]) <= high):
+            errors.append(f"Speedup of site {name} is {sites[name][8]}")
+    return errors
+
+def check_metadata(events, output):
+    errors = []
+    tid = get_track_tids(events).get("workers")
+    devices = [event for event in events if (event.get("ph") == "i") and (event["name"] == "device")]
+    if (len(devices) != 1) or (devices[0]["tid"] != tid) or (devices[0].get("args") != {"device": [3]}):
+        errors.append(f"Metadata events of track workers are {devices}")
+    tasks = [event for event in events if (event.get("ph") == "X") and (event["name"] == "itt_metadata::compute")]
+    if (len(tasks) != 1) or (tasks[0].get("args") != {"lanes": [16], "scale": [0.5], "ratio": [0.25], "mode": ["fast"]}):
+        errors.append(f"Arguments of task compute are {[event.get('args') for event in tasks]}")
+    return errors
+
+def check_threads(events, output):
+    errors = []
+    names = [(event["tid"], event["args"]["name"]) for event in events if (event.get("ph") == "M") and (event["name"] == "thread_name") and ("tid" in event)]
+    tasks = {event["name"]: event["tid"] for event in events if event.get("ph") == "X"}
+    if [name for tid, name in names if tid == tasks.get("itt_threads::work")] != ["metadata_worker"]:
+        errors.append("Thread of task work is not named metadata_worker once")
+    if sorted(name for tid, name in names if tid == tasks.get("itt_threads::load")) != ["decoder", "loader"]:
+        errors.append("Thread of tasks load and decode is not named loader and decoder")
+    if "progress" in [name for tid, name in names]:
+        errors.append("Ignored thread is named")
+    return errors
+
+# Checks of the ITT test cases in scenarios with --chrome-itt-logging:
+#   "summaries": titles of the ITT summaries that must be in the output
+#   "events": (phase, name) of events that must be in the trace
+#   "absent": names of events that must not be in the trace
+#   "paired": names of async events whose begins and ends must match
+#   "metadata": members of the "metadata" object of the trace
+#   "traces": number of trace files, 1 if not given, 0 if the test case logs no events
+#   "env": environment settings of the test case
+#   "check": function(events, output), events of all traces, returns a list of errors
+ITT_TESTS = {
+    "itt_counters": {"events": [("C", "itt_counters::queue_depth"), ("C", "itt_counters::load"), ("C", "itt_counters::credits")],
+                     "check": check_counters},
+    "itt_fork": {"traces": 2, "check": check_fork},
+    "itt_frames": {"summaries": ["ITT Frames"], "check": check_frames},
+    "itt_regions": {"summaries": ["ITT Regions"], "check": check_regions},
+    "itt_overlapped": {"summaries": ["ITT Overlapped Tasks"], "check": check_overlapped_tasks},
+    "itt_clocks": {"check": check_clocks},
+    "itt_histograms": {"summaries": ["ITT Histograms"], "check": check_histograms},
+    "itt_sync": {"summaries": ["ITT Sync Objects"], "events": [("X", "itt_sync::contention")], "check": check_sync},
+    "itt_heap": {"summaries": ["ITT Heap"], "check": check_heap},
+    "itt_relations": {"check": check_relations},
+    "itt_tracks": {"check": check_tracks},
+    "itt_mpi": {"summaries": ["ITT MPI Messages", "ITT MPI Progress"], "env": {"UNITRACE_ChromeMpiLogging": "1"}, "check": check_mpi},
+    "itt_marks": {"summaries": ["ITT Marks"], "check": check_marks},
+    "itt_fn_tasks": {"summaries": ["ITT Heap"], "env": {"UNITRACE_CclSummaryReport": "1"}, "check": check_fn_tasks},
+    "itt_modules": {"check": check_modules},
+    "itt_stitching": {"check": check_stitching},
+    "itt_model": {"summaries": ["ITT Model Sites"], "traces": 0, "env": {"UNITRACE_IttModelThreads": "4"}, "check": check_model},
+    "itt_metadata": {"metadata": {"build": ["release"], "runs": [1, 2]}, "absent": ["ignored"], "check": check_metadata},
+    "itt_pause": {"events": [("X", "itt_pause::collected"), ("X", "itt_pause::offload_paused"), ("X", "itt_pause::itt_paused")],
+                  "absent": ["itt_pause::host_paused", "itt_pause::all_paused"]},
+    "itt_threads": {"events": [("X", "itt_threads::work"), ("X", "itt_threads::load"), ("X", "itt_threads::decode"), ("X", "progress::progress")],
+                    "absent": ["itt_threads::poll"], "check": check_threads},
+}
+
 def extract_test_case_output(cmake_root_path, test_case_nmae, scenario):
     # Construct the path to the expected output file within the "gold" folder
     scenario = scenario.lstrip('-')
@@ -55,6 +339,66 @@ def call_unidiff(scenario, output_dir, output_file_with_pid, expected_output_fil
         print(f"[ERROR] Unknown scenario: {scenario}")
         return 1
 
+def split_scenario(scenario):
+    # A scenario is unitrace options, optionally preceded by NAME=VALUE environment settings,
+    # e.g. "UNITRACE_ShmCollector=1 --chrome-itt-logging"
+    settings = {}
+    options = scenario.split()
+    while options and ("=" in options[0]) and not options[0].startswith("-"):
+        name, value = options.pop(0).split("=", 1)
+        settings[name] = value
+    return settings, options
+
+def collect_itt_traces(trace_dir, test_case_name):
+    # traces in a container are extracted first
+    for container in glob.glob(os.path.join(trace_dir, "*.unitrace")):
+        script = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "scripts", "tracemerge", "containertrace.py")
+        subprocess.run([sys.executable, script, "--all", "-o", trace_dir, container], check = True)
+    return sorted(glob.glob(os.path.join(trace_dir, f"{test_case_name}.*.json")))
+
+def check_itt_trace(test_case_name, trace_dir, output_content):
+    spec = ITT_TESTS[test_case_name]
+    errors = []
+    for title in spec.get("summaries", []):
+        if title not in output_content:
+            errors.append(f"Summary '{title}' not found in output")
+
+    traces = collect_itt_traces(trace_dir, test_case_name)
+    if len(traces) != spec.get("traces", 1):
+        print(f"[ERROR] Expected {spec.get('traces', 1)} {test_case_name} traces in {trace_dir}, found {len(traces)}", file = sys.stderr)
+        return 1
+    all_events = []
+    metadata = {}
+    for trace_path in traces:
+        with open(trace_path, "r") as trace_file:
+            trace = json.load(trace_file)
+        all_events += trace["traceEvents"]
+        metadata.update(trace.get("metadata", {}))
+
+    events = {}
+    for event in all_events:
+        key = (event.get("ph"), event.get("name"))
+        events[key] = events.get(key, 0) + 1
+    for key in spec.get("events", []):
+        if key not in events:
+            errors.append(f"Event {key} not found")
+    for name in spec.get("paired", []):
+        if events.get(("b", name), 0) != events.get(("e", name), 0):
+            errors.append(f"Async events of {name} are not paired")
+    for key in events:
+        if key[1] in spec.get("absent", []):
+            errors.append(f"Event {key} should not be collected")
+    for name, value in spec.get("metadata", {}).items():
+        if metadata.get(name) != value:
+            errors.append(f"Metadata {name} is not {value}")
+    if "check" in spec:
+        errors += spec["check"](all_events, output_content)
+
+    for error in errors:
+        print(f"[ERROR] {error} in {test_case_name} traces {traces}", file = sys.stderr)
+    print(f"[INFO] ITT trace check complete. Result: {'Passed' if not errors else 'Failed'}")
+    return 1 if errors else 0
+
 def run_unitrace(cmake_root_path, scenario, test_case_nmae, args):
     output_dir = cmake_root_path + "/build/results"
     if platform.system() == "Windows":
@@ -69,7 +413,7 @@ def run_unitrace(cmake_root_path, scenario, test_case_nmae, args):
     os.makedirs(output_dir, exist_ok = True)
 
     # Generate a unique output file name
-    output_file = f"output_{scenario}_{os.path.basename(test_case)}.txt".replace("--", "_").replace("-", "_")
+    output_file = f"output_{scenario}_{os.path.basename(test_case)}.txt".replace("--", "_").replace("-", "_").replace(" ", "_").replace("=", "_").replace("/", "_")
     output_file_path = os.path.join(output_dir, output_file).replace("\\", "/")
 
     # Check if unitrace executable exists
@@ -82,13 +426,25 @@ def run_unitrace(cmake_root_path, scenario, test_case_nmae, args):
         print(f"[ERROR] Test case executable not found at {test_case}", file=sys.stderr)
         return 1
 
-    command = [unitrace_exe, "--opencl", scenario, "-o", output_file_path, test_case] + args
+    settings, options = split_scenario(scenario)
+    env = dict(os.environ, **settings)
+
+    # ITT test cases are checked in a trace directory of their own
+    check_itt = (test_case_nmae in ITT_TESTS) and ("--chrome-itt-logging" in options)
+    if check_itt:
+        trace_dir = os.path.join(output_dir, output_file.replace(".txt", "_traces"))
+        shutil.rmtree(trace_dir, ignore_errors = True)
+        os.makedirs(trace_dir)
+        options = options + ["--output-dir-path", trace_dir]
+        env.update(ITT_TESTS[test_case_nmae].get("env", {}))
+
+    command = [unitrace_exe, "--opencl"] + options + ["-o", output_file_path, test_case] + args
 
     print(f"[INFO] Executing command: {' '.join(command)}")
 
     try:
 
-        result = subprocess.run(command, text=True) # executing unitrace command
+        result = subprocess.run(command, text=True, env=env) # executing unitrace command
         if result.returncode != 0:
             print(f"[ERROR] Unitrace execution failed with return code {result.returncode}.", file = sys.stderr)
             return 1  # Indicate failure due to unitrace ERROR
@@ -115,6 +471,9 @@ def run_unitrace(cmake_root_path, scenario, test_case_nmae, args):
                 print(f"[ERROR] found in output file '{output_file}'.", file = sys.stderr)
                 return 1  # Indicate failure due to ERROR in output
 
+        if check_itt:
+            return check_itt_trace(test_case_nmae, trace_dir, output_content)
+
         # check for unidiff supported commands
         if scenario not in ["--device-timing", "-d", "--device-timeline", "-t"]:
             return 0 # unidiff.py not required for this scenario